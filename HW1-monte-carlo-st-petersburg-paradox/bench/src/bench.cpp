@@ -0,0 +1,111 @@
+#include "random_gen.h"
+#include "st_petersburg.h"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// Coin flips made by the games of the histogram: k Tails and the final Heads,
+// no Heads for games stopped by the bankroll
+double count_flips(const LevelHistogram & levels)
+{
+    double flips = 0;
+    for (unsigned level = 0; level <= levels.level_cap(); ++level) {
+        flips += static_cast<double>(levels.counts()[level]) * (level < levels.level_cap() ? level + 1 : level);
+    }
+    return flips;
+}
+
+// Args: engine, runs, bankroll, threads
+void BM_Engine(benchmark::State & state)
+{
+    SimulationOptions options;
+    options.engine = static_cast<Engine>(state.range(0));
+    const auto runs = static_cast<unsigned long>(state.range(1));
+    const auto bankroll = static_cast<double>(state.range(2));
+    options.threads = static_cast<unsigned>(state.range(3));
+    options.seed = 1;
+
+    double flips = 0;
+    for (auto _ : state) {
+        const auto levels = simulate_levels(runs, bankroll, options);
+        flips += count_flips(levels);
+        benchmark::DoNotOptimize(levels.mean());
+    }
+    state.counters["trials"] = benchmark::Counter(static_cast<double>(runs) * state.iterations(), benchmark::Counter::kIsRate);
+    state.counters["flips"] = benchmark::Counter(flips, benchmark::Counter::kIsRate);
+}
+
+void engine_args(benchmark::internal::Benchmark * b)
+{
+    b->ArgNames({"engine", "runs", "bankroll", "threads"});
+    for (const auto engine : {Engine::Flip, Engine::Bits, Engine::Lanes, Engine::Quasi}) {
+        for (const long runs : {100000L, 10000000L}) {
+            for (const long bankroll : {100L, 1000000L, 1000000000L}) {
+                for (const long threads : {1L, 4L}) {
+                    b->Args({static_cast<long>(engine), runs, bankroll, threads});
+                }
+            }
+        }
+    }
+    // Cost of the aggregate engine does not depend on runs
+    for (const long runs : {1000000L, 1000000000000L}) {
+        b->Args({static_cast<long>(Engine::Binomial), runs, 1000000L, 1L});
+    }
+}
+
+BENCHMARK(BM_Engine)->Apply(engine_args)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Generator cost alone, in blocks of 256 words as the engines draw them
+template <class Generator>
+void BM_Rng(benchmark::State & state)
+{
+    auto rnd = Generator::stream(1, 0);
+    std::uint64_t words[256];
+    for (auto _ : state) {
+        rnd.fill(words, 256);
+        benchmark::DoNotOptimize(words);
+    }
+    state.counters["words"] = benchmark::Counter(256.0 * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_TEMPLATE(BM_Rng, Xoshiro256);
+BENCHMARK_TEMPLATE(BM_Rng, Philox4x32);
+BENCHMARK_TEMPLATE(BM_Rng, Pcg64);
+BENCHMARK_TEMPLATE(BM_Rng, Mt19937);
+
+// Mixed batch of one long and many short jobs. Args: stealing, threads.
+// Without stealing every job is a simulate_levels() call of its own
+void BM_MixedBatch(benchmark::State & state)
+{
+    SimulationOptions options;
+    options.engine = Engine::Bits;
+    options.threads = static_cast<unsigned>(state.range(1));
+    options.seed = 1;
+    std::vector<BatchJob> jobs = {{20000000, 1000000000}};
+    for (unsigned i = 0; i < 64; ++i) {
+        jobs.push_back({100000, 1000.0 * (i + 1)});
+    }
+    unsigned long runs = 0;
+    for (const auto & job : jobs) {
+        runs += job.runs;
+    }
+
+    for (auto _ : state) {
+        if (state.range(0) != 0) {
+            benchmark::DoNotOptimize(simulate_batch(jobs, options));
+        }
+        else {
+            for (const auto & job : jobs) {
+                benchmark::DoNotOptimize(simulate_levels(job.runs, job.bankroll, options));
+            }
+        }
+    }
+    state.counters["trials"] = benchmark::Counter(static_cast<double>(runs) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_MixedBatch)->ArgNames({"stealing", "threads"})->ArgsProduct({{0, 1}, {1, 4}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // anonymous namespace
+
+BENCHMARK_MAIN();
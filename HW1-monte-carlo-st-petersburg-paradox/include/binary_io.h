@@ -0,0 +1,76 @@
+#pragma once
+
+#include "game_rules.h"
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+// Fixed-width little-endian fields of the binary files, independent of the host
+
+inline void write_u64(std::ostream & out, const std::uint64_t value)
+{
+    char bytes[8];
+    for (unsigned i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.write(bytes, 8);
+}
+
+// Throws std::runtime_error at the end of the stream
+inline std::uint64_t read_u64(std::istream & in)
+{
+    unsigned char bytes[8];
+    if (!in.read(reinterpret_cast<char *>(bytes), 8)) {
+        throw std::runtime_error("Truncated file");
+    }
+    std::uint64_t value = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        value |= std::uint64_t{bytes[i]} << (8 * i);
+    }
+    return value;
+}
+
+inline void write_double(std::ostream & out, const double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    write_u64(out, bits);
+}
+
+inline double read_double(std::istream & in)
+{
+    const std::uint64_t bits = read_u64(in);
+    double value;
+    std::memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+inline void write_rules(std::ostream & out, const GameRules & rules)
+{
+    write_double(out, rules.initial_bet);
+    write_double(out, rules.multiplier);
+    write_double(out, rules.tails_probability);
+    write_u64(out, static_cast<std::uint64_t>(rules.cap));
+    write_u64(out, rules.max_rounds);
+}
+
+// Throws std::runtime_error if the cap policy or max_rounds is out of range
+inline GameRules read_rules(std::istream & in)
+{
+    GameRules rules;
+    rules.initial_bet = read_double(in);
+    rules.multiplier = read_double(in);
+    rules.tails_probability = read_double(in);
+    const std::uint64_t cap = read_u64(in);
+    const std::uint64_t max_rounds = read_u64(in);
+    if (cap > static_cast<std::uint64_t>(CapPolicy::Rounds) || max_rounds > std::numeric_limits<unsigned>::max()) {
+        throw std::runtime_error("Malformed game rules");
+    }
+    rules.cap = static_cast<CapPolicy>(cap);
+    rules.max_rounds = static_cast<unsigned>(max_rounds);
+    return rules;
+}
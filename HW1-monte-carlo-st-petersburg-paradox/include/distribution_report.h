@@ -0,0 +1,43 @@
+#pragma once
+
+#include "level_histogram.h"
+#include "st_petersburg.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Distribution of the capped payout of a number of games
+struct DistributionReport
+{
+    double bankroll = 0;
+    std::uint64_t runs = 0;
+    double mean = 0;
+    double std_error = 0;
+    double std_dev = 0;
+    double median = 0;
+    double p99 = 0;
+    double p999 = 0;
+    // Share of games stopped by the cap, with its standard error
+    double cap_probability = 0;
+    double cap_probability_error = 0;
+
+    // Games per level with their payout
+    struct Level
+    {
+        unsigned level = 0;
+        double payout = 0;
+        std::uint64_t count = 0;
+    };
+    std::vector<Level> levels;
+};
+
+// The histogram of the simulation already is the whole distribution:
+// it is collected per worker and merged, its size depends on the bankroll only
+DistributionReport make_distribution_report(const LevelHistogram & levels);
+DistributionReport distribution_report(unsigned long runs, double bankroll, const SimulationOptions & options);
+
+// One header line and one line of the summary
+void write_report_csv(std::ostream & out, const DistributionReport & report);
+// Summary and the games per level
+void write_report_json(std::ostream & out, const DistributionReport & report);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "running_stats.h"
+#include "st_petersburg.h"
+
+#include <cstdint>
+#include <vector>
+
+// Casino that pays every win out of one bankroll: players come one after another,
+// each pays the fee, and the win of the game is taken from the bankroll.
+// The casino is ruined by the first win above its bankroll and the fee, a win
+// that takes all of them is still paid in full
+struct CasinoModel
+{
+    double capital = 1000000;
+    double fee = 20;
+    // Games of one history when the casino is not ruined
+    unsigned long max_games = 100000;
+};
+
+// Outcome of independent histories of the casino
+struct EnsembleResult
+{
+    unsigned long histories = 0;
+    // Share of ruined histories with its 95% confidence interval
+    Estimate ruin_probability;
+    // Number of the game that ruined the casino (from 1), sorted, one per ruined history
+    std::vector<std::uint64_t> ruin_times;
+    // Mean bankroll of the histories that survived max_games, 0 if none did
+    double mean_final_capital = 0;
+
+    // Smallest ruin time t with P(ruin time <= t | ruined) >= p, 0 if no history was ruined
+    std::uint64_t ruin_time_quantile(double p) const;
+};
+
+// Histories are played in blocks of lanes with struct-of-arrays state, one flip
+// sampler draw per lane and game. Blocks are spread over options.threads workers
+// that steal from each other, each block has its own generator seeded by the
+// seed and the block, so the result does not depend on the threads.
+// The game follows options.rules, the bankroll caps every win; engine and estimator are not used
+EnsembleResult simulate_ensemble(unsigned long histories, const CasinoModel & model, const SimulationOptions & options);
@@ -0,0 +1,35 @@
+#pragma once
+
+// Where a game that keeps getting Tails is stopped
+enum class CapPolicy
+{
+    // The bank pays at most the bankroll, the game stops once the win reaches it
+    Bankroll,
+    // Martingale cap: the game stops after max_rounds Tails, the win is paid in full
+    Rounds
+};
+
+// Levels of a game beyond the first, the most any histogram holds
+constexpr unsigned LEVEL_LIMIT = 1023;
+
+// The win starts at initial_bet and is multiplied by `multiplier` on every Tails,
+// the first Heads stops the game and the win is paid. Defaults are the classic game
+struct GameRules
+{
+    double initial_bet = 2;
+    double multiplier = 2;
+    // Probability of Tails, the outcome that continues the game
+    double tails_probability = 0.5;
+    CapPolicy cap = CapPolicy::Bankroll;
+    // Limit of CapPolicy::Rounds
+    unsigned max_rounds = 0;
+
+    bool fair_coin() const { return tails_probability == 0.5; }
+    bool standard() const;
+    // Throws std::invalid_argument for rules without a well-defined game or
+    // with more levels than LEVEL_LIMIT, which a histogram can not hold
+    void validate() const;
+};
+
+bool operator==(const GameRules & lhs, const GameRules & rhs);
+inline bool operator!=(const GameRules & lhs, const GameRules & rhs) { return !(lhs == rhs); }
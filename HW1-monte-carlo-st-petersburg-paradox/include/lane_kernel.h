@@ -0,0 +1,85 @@
+#pragma once
+
+// Lane-parallel game loop shared by the per-instruction-set translation units.
+// Each unit includes it with its own target flags, so everything here has
+// internal linkage to keep the differently compiled copies apart. Nothing here
+// may instantiate standard-library templates: their weak copies built for one
+// instruction set could end up in the whole binary.
+
+#include "lanes.h"
+
+#include <cstdint>
+
+namespace {
+
+// Lanes hold a whole game each: on every step a lane takes one bit of its
+// own word, Tails double the win (level + 1), Heads or the cap retire the game
+// into the histogram and the lane starts the next one.
+// Vec is a LANES x uint64 vector: Vec::set1, load, store, add, sub, bit ops,
+// shifts by a constant, cmpeq/cmpgt giving all-ones lanes and movemask.
+// lane_counts is zeroed scratch of LANES x (level_cap + 1) counts from the caller.
+template <class Vec>
+void play_lanes_kernel(const std::uint64_t (&state)[4][LANES], const std::uint64_t (&quota)[LANES], const unsigned level_cap, std::uint64_t * lane_counts, std::uint64_t * counts)
+{
+    Vec s0 = Vec::load(state[0]);
+    Vec s1 = Vec::load(state[1]);
+    Vec s2 = Vec::load(state[2]);
+    Vec s3 = Vec::load(state[3]);
+    // Vectorized xoshiro256**, multiplications by 5 and 9 as shift-adds
+    const auto next = [&]() {
+        const Vec x = Vec::add(Vec::template shl<2>(s1), s1);
+        const Vec r = Vec::bit_or(Vec::template shl<7>(x), Vec::template shr<57>(x));
+        const Vec result = Vec::add(Vec::template shl<3>(r), r);
+        const Vec t = Vec::template shl<17>(s1);
+        s2 = Vec::bit_xor(s2, s0);
+        s3 = Vec::bit_xor(s3, s1);
+        s1 = Vec::bit_xor(s1, s2);
+        s0 = Vec::bit_xor(s0, s3);
+        s2 = Vec::bit_xor(s2, t);
+        s3 = Vec::bit_or(Vec::template shl<45>(s3), Vec::template shr<19>(s3));
+        return result;
+    };
+
+    const Vec one = Vec::set1(1);
+    const Vec cap = Vec::set1(level_cap);
+    const Vec target = Vec::load(quota);
+    Vec level = Vec::set1(0);
+    Vec done = Vec::set1(0);
+    Vec active = Vec::cmpgt(target, done);
+    Vec word = next();
+    unsigned bits_left = 64;
+    std::uint64_t retired_level[LANES];
+    const unsigned row = level_cap + 1;
+
+    while (Vec::movemask(active) != 0) {
+        if (bits_left == 0) {
+            word = next();
+            bits_left = 64;
+        }
+        const Vec tails = Vec::bit_and(Vec::cmpeq(Vec::bit_and(word, one), one), Vec::cmpgt(cap, level));
+        word = Vec::template shr<1>(word);
+        --bits_left;
+        // Masked doubling: all-ones lanes are -1
+        level = Vec::sub(level, tails);
+        const Vec retire = Vec::bit_andnot(tails, active);
+        // Some lane retires on almost every step, so the tally is branchless:
+        // per-lane rows keep lanes from waiting on each other's counter
+        const unsigned mask = Vec::movemask(retire);
+        Vec::store(retired_level, level);
+        for (unsigned lane = 0; lane < LANES; ++lane) {
+            lane_counts[lane * row + retired_level[lane]] += (mask >> lane) & 1;
+        }
+        // Retired lanes refill with a new game while they have quota
+        level = Vec::bit_andnot(retire, level);
+        done = Vec::sub(done, retire);
+        active = Vec::cmpgt(target, done);
+    }
+
+    for (unsigned lane = 0; lane < LANES; ++lane) {
+        for (unsigned level = 0; level < row; ++level) {
+            counts[level] += lane_counts[lane * row + level];
+        }
+    }
+}
+
+} // anonymous namespace
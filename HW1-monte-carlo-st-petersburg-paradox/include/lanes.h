@@ -0,0 +1,27 @@
+#pragma once
+
+#include "level_histogram.h"
+
+#include <cstdint>
+
+// Instruction set of the lane-parallel engine
+enum class LaneIsa
+{
+    // Best one supported by the CPU
+    Auto,
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+// Games played at once, the same for every instruction set so that
+// results do not depend on the one picked
+constexpr unsigned LANES = 8;
+
+// Best instruction set both compiled in and supported by the CPU
+LaneIsa detect_lane_isa();
+bool lane_isa_supported(LaneIsa isa);
+
+// Plays `games` games in LANES vector lanes, each with its own xoshiro256**
+// stream: stream `first_stream + lane` of `seed`
+void play_lanes(unsigned long games, std::uint64_t seed, std::uint64_t first_stream, LaneIsa isa, LevelHistogram & levels);
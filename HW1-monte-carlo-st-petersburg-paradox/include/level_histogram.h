@@ -0,0 +1,53 @@
+#pragma once
+
+#include "game_rules.h"
+
+#include <cstdint>
+#include <vector>
+
+// Doublings after which the win reaches bankroll, limited to stay finite
+unsigned max_level(double bankroll);
+// Tails after which a game under `rules` is stopped
+unsigned max_level(double bankroll, const GameRules & rules);
+
+// Probability that a game stops at `level` when it can not go beyond `level_cap`
+double level_probability(unsigned level, unsigned level_cap, double tails_probability = 0.5);
+
+// Exact outcome of a number of games: a game stopped after k doublings
+// (level k) pays min(2^(k+1), bankroll), so counts per level determine everything.
+// Under other rules level k pays initial_bet * multiplier^k within the cap
+class LevelHistogram
+{
+public:
+    explicit LevelHistogram(double bankroll, const GameRules & rules = GameRules{});
+
+    void add(const unsigned level) { ++m_counts[level]; }
+    void add(unsigned level, std::uint64_t count);
+
+    // Both histograms must be built for the same bankroll and rules
+    void merge(const LevelHistogram & other);
+
+    double bankroll() const { return m_bankroll; }
+    const GameRules & rules() const { return m_rules; }
+    unsigned level_cap() const { return static_cast<unsigned>(m_counts.size() - 1); }
+    const std::vector<std::uint64_t> & counts() const { return m_counts; }
+    std::uint64_t runs() const;
+
+    double payout(unsigned level) const;
+
+    // Same games paid under a bankroll not above the current one:
+    // levels at or beyond the new cap fold into it
+    LevelHistogram with_bankroll(double bankroll) const;
+
+    // Mean payout, 0 if there were no games
+    double mean() const;
+    // Unbiased sample variance of a single payout, 0 if there were less than 2 games
+    double variance() const;
+    // Smallest payout x with P(payout <= x) >= p
+    double quantile(double p) const;
+
+private:
+    double m_bankroll;
+    GameRules m_rules;
+    std::vector<std::uint64_t> m_counts;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Worker threads to use for `tasks` independent pieces of work
+inline unsigned resolve_threads(const unsigned long tasks, const unsigned requested)
+{
+    unsigned long threads = requested > 0 ? requested : std::thread::hardware_concurrency();
+    // hardware_concurrency() may be unknown, no point in idle workers either
+    threads = std::min(std::max(threads, 1UL), std::max(tasks, 1UL));
+    return static_cast<unsigned>(threads);
+}
+
+// First of `total` items owned by part `index` of `parts` contiguous parts
+inline unsigned long part_begin(const unsigned long total, const unsigned parts, const unsigned index)
+{
+    return total / parts * index + std::min<unsigned long>(index, total % parts);
+}
+
+inline unsigned long part_size(const unsigned long total, const unsigned parts, const unsigned index)
+{
+    return total / parts + (index < total % parts ? 1 : 0);
+}
+
+// Calls work(index) for every index in [0; threads), index 0 runs on the calling thread
+template <class Work>
+void run_workers(const unsigned threads, const Work & work)
+{
+    std::vector<std::thread> workers;
+    workers.reserve(threads > 0 ? threads - 1 : 0);
+    for (unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back(work, i);
+    }
+    work(0U);
+    for (auto & worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "level_histogram.h"
+#include "running_stats.h"
+#include "st_petersburg.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Games `first_trial` (SimulationOptions::first_trial) to `first_trial + trials`
+// of the streams of one seed and generator
+struct TrialRange
+{
+    std::uint64_t seed = 0;
+    Rng rng = Rng::Xoshiro;
+    std::uint64_t first_trial = 0;
+    std::uint64_t trials = 0;
+
+    bool same_stream(const TrialRange & other) const { return seed == other.seed && rng == other.rng; }
+};
+
+// Games of one process, saved to be combined with the games of other processes
+struct PartialResult
+{
+    Engine engine = Engine::Flip;
+    // Where the games come from: one range for a single process,
+    // a merge keeps the ranges of every seed and generator it combines
+    std::vector<TrialRange> ranges;
+    LevelHistogram levels{1};
+    // Count, mean and variance of the payouts
+    RunningStats moments;
+
+    std::uint64_t trials() const { return levels.runs(); }
+};
+
+// Result of simulate_levels() called with `options`, the seed must be set
+PartialResult make_partial_result(const LevelHistogram & levels, const SimulationOptions & options);
+
+// Versioned little-endian binary format,
+// reading throws std::runtime_error if the file is malformed
+void write_partial_result(std::ostream & out, const PartialResult & result);
+void write_partial_result(const std::string & path, const PartialResult & result);
+PartialResult read_partial_result(std::istream & in);
+PartialResult read_partial_result(const std::string & path);
+
+// Union of independent games, throws std::invalid_argument if the bankrolls or rules differ
+// or two results share games (same seed and generator, overlapping trial ranges).
+// Adjacent ranges of one seed and generator are joined into one
+PartialResult merge_partial_results(const std::vector<PartialResult> & results);
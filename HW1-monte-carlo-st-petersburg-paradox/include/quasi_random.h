@@ -0,0 +1,61 @@
+#pragma once
+
+#include "random_gen.h"
+
+#include <cstdint>
+
+// Van der Corput sequence in base 2 (the first dimension of Sobol) with Owen's
+// nested uniform scrambling: bit j of point i is bit j of reverse(i) flipped by
+// a random bit keyed by j and the bits of reverse(i) above it. Every point is
+// uniform on [0;1) and the first 2^m points still hit every interval [k/2^m; (k+1)/2^m)
+class ScrambledVanDerCorput
+{
+public:
+    explicit ScrambledVanDerCorput(const std::uint64_t seed)
+        : m_seed(seed)
+    {
+    }
+
+    // Leading zero bits of point `index`, i.e. floor(-log2(u)), but no more than `limit`:
+    // a fair game stops at this level, and only the bits up to the first 1 are scrambled
+    unsigned leading_zeros(const std::uint64_t index, const unsigned limit) const
+    {
+        const std::uint64_t point = reverse_bits(index);
+        for (unsigned j = 0; j < limit; ++j) {
+            if (bit(point, j)) {
+                return j;
+            }
+        }
+        return limit;
+    }
+
+    // Point `index` as a double from [0;1)
+    double operator()(const std::uint64_t index) const
+    {
+        const std::uint64_t point = reverse_bits(index);
+        std::uint64_t word = 0;
+        for (unsigned j = 0; j < 53; ++j) {
+            word |= std::uint64_t{bit(point, j)} << (63 - j);
+        }
+        return to_unit_double(word);
+    }
+
+    static std::uint64_t reverse_bits(std::uint64_t x)
+    {
+        x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+        x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0F) | ((x & 0x0F0F0F0F0F0F0F0F) << 4);
+        return __builtin_bswap64(x);
+    }
+
+private:
+    // Bit j from the top of the scrambled point, digits below 2^-64 are zero before scrambling
+    bool bit(const std::uint64_t point, const unsigned j) const
+    {
+        const std::uint64_t prefix = j == 0 ? 0 : (j >= 64 ? point : point >> (64 - j));
+        const bool digit = j < 64 && ((point >> (63 - j)) & 1) != 0;
+        return digit != ((mix_seed(mix_seed(m_seed, j), prefix) & 1) != 0);
+    }
+
+    std::uint64_t m_seed;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "level_histogram.h"
+#include "running_stats.h"
+#include "st_petersburg.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One simulation asked of the server: games are played in chunks
+// until the 95% interval is narrow enough or `runs` games are played
+struct Query
+{
+    unsigned long runs = 1000000;
+    double bankroll = 1000000;
+    // Target half-width of the interval, 0 plays every game
+    double absolute_error = 0;
+    double relative_error = 0;
+    // Engine::Quasi is not served: its points do not split into chunks
+    Engine engine = Engine::Flip;
+    Rng rng = Rng::Philox;
+    // Seed of the games, drawn by the server when not set
+    std::optional<std::uint64_t> seed;
+};
+
+enum class ReplyKind
+{
+    // Games merged so far, sent after every chunk
+    Progress,
+    // Last reply to a query
+    Done,
+    // Query was rejected, nothing else follows
+    Error
+};
+
+struct Reply
+{
+    ReplyKind kind = ReplyKind::Progress;
+    // Seed the games are played with
+    std::uint64_t seed = 0;
+    Estimate estimate;
+    std::string error;
+};
+
+// Payloads of the frames, little-endian binary_io fields.
+// Reading throws std::runtime_error if the payload is malformed
+void write_query(std::ostream & out, const Query & query);
+Query read_query(std::istream & in);
+void write_reply(std::ostream & out, const Reply & reply);
+Reply read_reply(std::istream & in);
+
+// Simulation daemon on a Unix domain socket. Every frame is a 64-bit length
+// and a payload; a client sends a query and gets progress replies and
+// a final one before it sends the next query.
+// The worker pool is started once: workers take chunks of the queries in
+// round robin, so a long query does not hold back the short ones, and play
+// each chunk on a single thread with its own streams keyed by the index of its
+// first game. For a fixed seed the games do not depend on the scheduling.
+class QueryServer
+{
+public:
+    // Binds the socket, replacing a stale file at `path`,
+    // throws std::runtime_error if it can not
+    QueryServer(const std::string & path, unsigned threads = 0, unsigned long chunk = 1UL << 20);
+    // Stops the server and removes the socket file
+    ~QueryServer();
+
+    QueryServer(const QueryServer &) = delete;
+    QueryServer & operator=(const QueryServer &) = delete;
+
+    // Serves connections on the calling thread until stop()
+    void run();
+    // Safe to call from any thread, queries being played are abandoned
+    void stop();
+
+    unsigned threads() const { return static_cast<unsigned>(m_workers.size()); }
+    // Clients connected now, a client that leaves in the middle of a query
+    // is dropped with the rest of its games after the next failed reply
+    std::size_t connections();
+
+private:
+    struct Connection;
+    struct Job;
+
+    void work();
+    // Reader of a connection: queries one after another until the client leaves
+    void serve(std::shared_ptr<Connection> connection);
+    void play(const std::shared_ptr<Connection> & connection);
+
+    const std::string m_path;
+    const unsigned long m_chunk;
+    int m_listen_fd = -1;
+    // Written to by stop() to wake run()
+    int m_wake_fds[2] = {-1, -1};
+
+    std::mutex m_mutex;
+    // Signalled when a job is queued and when one is finished
+    std::condition_variable m_changed;
+    // Jobs with chunks left to claim, in round robin order
+    std::deque<std::shared_ptr<Job>> m_queue;
+    // Open connections, a reader removes its own when the client leaves
+    std::vector<std::shared_ptr<Connection>> m_connections;
+    bool m_stopping = false;
+
+    // Readers of the connections are detached, the destructor waits for them
+    unsigned m_readers = 0;
+
+    std::vector<std::thread> m_workers;
+};
+
+// Blocking client of one connection
+class QueryClient
+{
+public:
+    // Throws std::runtime_error if the server is not reachable
+    explicit QueryClient(const std::string & path);
+    ~QueryClient();
+
+    QueryClient(const QueryClient &) = delete;
+    QueryClient & operator=(const QueryClient &) = delete;
+
+    // Sends the query, calls on_progress for every progress reply and returns the final one.
+    // Throws std::runtime_error if the query is rejected or the connection is lost
+    Reply run(const Query & query, const std::function<void(const Reply &)> & on_progress = nullptr);
+
+private:
+    int m_fd = -1;
+};
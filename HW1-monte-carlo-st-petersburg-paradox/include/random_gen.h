@@ -1,3 +1,287 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+// Uniform double from [0;1) of the calling thread's engine
 double get_random_number();
+
+// Bulk draws from the calling thread's engine, cheaper per number than
+// get_random_number(): uniform doubles from [0;1) or raw 64-bit words
+void fill_random_numbers(double * out, std::size_t n);
+void fill_random_bits(std::uint64_t * out, std::size_t n);
+
+// Fresh seed from std::random_device, used when caller does not fix one
+std::uint64_t make_random_seed();
+
+// Seed of an independent sequence derived from `seed` and `value`
+std::uint64_t mix_seed(std::uint64_t seed, std::uint64_t value);
+
+// Uniform double from [0;1) made of the upper 53 bits of a raw word
+inline double to_unit_double(const std::uint64_t word)
+{
+    return static_cast<double>(word >> 11) * 0x1.0p-53;
+}
+
+// Tails before the first Heads of a coin with log(Tails probability) = log_tails,
+// but no more than `limit`, from one uniform u from [0;1) by inversion:
+// P(floor(log(1 - u) / log(p)) >= k) = P(1 - u <= p^k) = p^k
+inline unsigned geometric_tails(const double u, const double log_tails, const unsigned limit)
+{
+    // 1 - u is from (0;1], so the logarithm stays finite
+    const double tails = std::floor(std::log(1 - u) / log_tails);
+    return tails < limit ? static_cast<unsigned>(tails) : limit;
+}
+
+// Generator policies of the Monte Carlo engine. Each one is a 64-bit uniform
+// random bit generator with next_double(), fill() and a static stream(seed, id)
+// giving non-overlapping streams; the per-number path is defined inline so that
+// it folds into the game loop.
+
+// xoshiro256** generator, cheap to copy and safe to own one per thread
+class Xoshiro256
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit Xoshiro256(std::uint64_t seed);
+
+    // Stream `stream_id` of the sequence defined by `seed`: distinct streams
+    // are 2^128 draws apart, so they never overlap in practice
+    static Xoshiro256 stream(std::uint64_t seed, std::uint64_t stream_id);
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        const std::uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+        const std::uint64_t t = m_state[1] << 17;
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = rotl(m_state[3], 45);
+        return result;
+    }
+
+    // Uniform double from [0;1)
+    double next_double() { return to_unit_double((*this)()); }
+
+    // Next `n` draws of operator() or next_double() at once
+    void fill(std::uint64_t * out, std::size_t n);
+    void fill(double * out, std::size_t n);
+
+    // Advance the state by 2^128 draws
+    void jump();
+
+    // Raw state words, for vectorized copies of the generator
+    std::array<std::uint64_t, 4> state() const { return m_state; }
+
+private:
+    static std::uint64_t rotl(const std::uint64_t x, const int k) { return (x << k) | (x >> (64 - k)); }
+
+    std::array<std::uint64_t, 4> m_state;
+};
+
+// PCG64 (XSL RR 128/64), streams are its native increments
+class Pcg64
+{
+public:
+    using result_type = std::uint64_t;
+
+    Pcg64(std::uint64_t seed, std::uint64_t stream_id);
+
+    static Pcg64 stream(const std::uint64_t seed, const std::uint64_t stream_id) { return Pcg64(seed, stream_id); }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        m_state = m_state * MULTIPLIER + m_increment;
+        const auto rotation = static_cast<unsigned>(m_state >> 122);
+        const auto xored = static_cast<std::uint64_t>(m_state >> 64) ^ static_cast<std::uint64_t>(m_state);
+        return (xored >> rotation) | (xored << ((64 - rotation) & 63));
+    }
+
+    double next_double() { return to_unit_double((*this)()); }
+
+    void fill(std::uint64_t * out, std::size_t n);
+    void fill(double * out, std::size_t n);
+
+private:
+    __extension__ using uint128 = unsigned __int128;
+
+    static constexpr uint128 MULTIPLIER = (static_cast<uint128>(0x2360ED051FC65DA4) << 64) | 0x4385DF649FCCF645;
+
+    uint128 m_state;
+    uint128 m_increment;
+};
+
+// Standard 64-bit Mersenne Twister, streams are split seeds
+class Mt19937
+{
+public:
+    using result_type = std::uint64_t;
+
+    Mt19937(std::uint64_t seed, std::uint64_t stream_id);
+
+    static Mt19937 stream(const std::uint64_t seed, const std::uint64_t stream_id) { return Mt19937(seed, stream_id); }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() { return m_engine(); }
+
+    double next_double() { return to_unit_double((*this)()); }
+
+    void fill(std::uint64_t * out, std::size_t n);
+    void fill(double * out, std::size_t n);
+
+private:
+    std::mt19937_64 m_engine;
+};
+
+// Counter-based Philox4x32-10 generator: the output is a pure function of
+// (key, trial, position), so any trial can be replayed on any thread
+class Philox4x32
+{
+public:
+    using result_type = std::uint64_t;
+    using Counter = std::array<std::uint32_t, 4>;
+    using Key = std::array<std::uint32_t, 2>;
+
+    Philox4x32(std::uint64_t key, std::uint64_t trial);
+
+    // Streams are trials
+    static Philox4x32 stream(const std::uint64_t seed, const std::uint64_t stream_id) { return Philox4x32(seed, stream_id); }
+
+    // Raw bijection of the counter under the key
+    static Counter block(Counter counter, Key key)
+    {
+        for (int round = 0; round < 10; ++round) {
+            const std::uint64_t product0 = std::uint64_t{0xD2511F53} * counter[0];
+            const std::uint64_t product1 = std::uint64_t{0xCD9E8D57} * counter[2];
+            counter = {static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                       static_cast<std::uint32_t>(product1),
+                       static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                       static_cast<std::uint32_t>(product0)};
+            key[0] += 0x9E3779B9;
+            key[1] += 0xBB67AE85;
+        }
+        return counter;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        if (m_used == 4) {
+            m_buffer = block(m_counter, m_key);
+            // Low 64 bits of the counter enumerate blocks within the trial
+            if (++m_counter[0] == 0) {
+                ++m_counter[1];
+            }
+            m_used = 0;
+        }
+        const std::uint64_t result = (static_cast<std::uint64_t>(m_buffer[m_used + 1]) << 32) | m_buffer[m_used];
+        m_used += 2;
+        return result;
+    }
+
+    // Uniform double from [0;1)
+    double next_double() { return to_unit_double((*this)()); }
+
+    // Next `n` draws of operator() or next_double() at once
+    void fill(std::uint64_t * out, std::size_t n);
+    void fill(double * out, std::size_t n);
+
+private:
+    Counter m_counter;
+    Key m_key;
+    Counter m_buffer;
+    unsigned m_used;
+};
+
+// Runtime choice of the generator policy
+enum class Rng
+{
+    // One xoshiro256** stream per worker thread, result depends on thread count
+    Xoshiro,
+    // Counter-based Philox keyed by seed and trial index, result does not depend on thread count
+    Philox,
+    // One PCG64 stream per worker thread
+    Pcg64,
+    // One 64-bit Mersenne Twister per worker thread
+    Mt19937
+};
+
+// Calls visit(generator) with stream `stream_id` of the policy picked by `rng`,
+// so that the caller is instantiated once per policy
+template <class Visit>
+void with_generator(const Rng rng, const std::uint64_t seed, const std::uint64_t stream_id, const Visit & visit)
+{
+    switch (rng) {
+    case Rng::Xoshiro: {
+        auto rnd = Xoshiro256::stream(seed, stream_id);
+        visit(rnd);
+        break;
+    }
+    case Rng::Philox: {
+        auto rnd = Philox4x32::stream(seed, stream_id);
+        visit(rnd);
+        break;
+    }
+    case Rng::Pcg64: {
+        auto rnd = Pcg64::stream(seed, stream_id);
+        visit(rnd);
+        break;
+    }
+    case Rng::Mt19937: {
+        auto rnd = Mt19937::stream(seed, stream_id);
+        visit(rnd);
+        break;
+    }
+    }
+}
+
+// Words of a generator drawn a block at a time, so that taking the next one
+// is an array read instead of a call into the generator
+template <class Generator, std::size_t Block = 256>
+class Prefetched
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit Prefetched(Generator & rnd)
+        : m_rnd(rnd)
+    {
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        if (m_pos == Block) {
+            m_rnd.fill(m_words.data(), Block);
+            m_pos = 0;
+        }
+        return m_words[m_pos++];
+    }
+
+    // Same number as Generator::next_double() would give
+    double next_double() { return to_unit_double((*this)()); }
+
+private:
+    Generator & m_rnd;
+    std::array<std::uint64_t, Block> m_words;
+    std::size_t m_pos = Block;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "level_histogram.h"
+#include "running_stats.h"
+#include "st_petersburg.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Games of a seed change whenever an engine or a generator plays them differently,
+// entries of older versions are never matched
+constexpr std::uint64_t ENGINE_VERSION = 1;
+
+// Histograms of seeded simulations kept in a memory-mapped file shared by processes.
+// An entry is addressed by a hash of everything that decides the games: engine
+// version, seed, generator, engine, first game, bankroll, rules and, where the
+// streams depend on them, threads or replicates. The file holds a fixed number of
+// slots, an entry goes to one of the few slots from its hash on, and the least
+// recently used of them is evicted when all are taken. One object may be shared
+// by threads, queries wait for each other only while they read or store an entry.
+class ResultCache
+{
+public:
+    // Bankrolls with more levels are not cached, classic game up to 2^128
+    static constexpr unsigned MAX_LEVELS = 128;
+
+    // Opens the cache at `path` or creates one of at most `max_bytes`,
+    // an existing file keeps its size. Throws std::runtime_error if the file
+    // can not be mapped or is not a cache
+    explicit ResultCache(const std::string & path, std::size_t max_bytes = 16 << 20);
+    ~ResultCache();
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache & operator=(const ResultCache &) = delete;
+
+    // Same games as ::simulate_levels(). A query with a seed is answered from the cache,
+    // a Philox query of the Flip or Bits engine also extends a cached shorter run
+    // by the missing games. Queries without a seed, and cached games, skip the observer
+    LevelHistogram simulate_levels(unsigned long runs, double bankroll, const SimulationOptions & options);
+    // Plain estimator only, the others and the replicate error of Engine::Quasi are computed every time
+    double calculate_expected_value(unsigned long runs, double bankroll, const SimulationOptions & options);
+    Estimate estimate_expected_value(unsigned long runs, double bankroll, const SimulationOptions & options);
+
+    // Entries that fit in the file and entries stored now
+    std::size_t capacity() const { return m_slots; }
+    std::size_t size() const;
+    void clear();
+
+    // Queries of this object answered without playing any game, by extending a cached run, by playing all games
+    std::uint64_t hits() const { return m_hits.load(); }
+    std::uint64_t extensions() const { return m_extensions.load(); }
+    std::uint64_t misses() const { return m_misses.load(); }
+
+private:
+    struct Slot;
+    struct Key;
+    class Lock;
+
+    Slot & slot(std::size_t index) const;
+    // Slots probed for one hash
+    std::size_t probe() const;
+
+    int m_fd = -1;
+    void * m_data = nullptr;
+    std::size_t m_bytes = 0;
+    std::size_t m_slots = 0;
+    mutable std::mutex m_mutex;
+    std::atomic<std::uint64_t> m_hits{0};
+    std::atomic<std::uint64_t> m_extensions{0};
+    std::atomic<std::uint64_t> m_misses{0};
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "level_histogram.h"
+
+#include <cstdint>
+
+// Estimate of a mean with its confidence interval
+struct Estimate
+{
+    double mean = 0;
+    double std_error = 0;
+    // Confidence interval
+    double low = 0;
+    double high = 0;
+    unsigned long runs = 0;
+    // Variance of the plain estimator over the one of this estimator,
+    // i.e. how many times fewer games give the same accuracy
+    double variance_reduction = 1;
+};
+
+// Interval of the normal approximation with the given coverage probability
+Estimate make_estimate(double mean, double std_error, unsigned long runs, double confidence);
+
+// Welford mean and variance of a stream of values, partial results
+// of independent workers merge into the statistics of the union
+class RunningStats
+{
+public:
+    RunningStats() = default;
+    // Every game of the histogram as one value
+    explicit RunningStats(const LevelHistogram & levels);
+    // Statistics of `count` values with the given mean and unbiased variance
+    static RunningStats from_moments(std::uint64_t count, double mean, double variance);
+
+    void add(double value);
+    // `count` copies of the same value
+    void add(double value, std::uint64_t count);
+    void merge(const RunningStats & other);
+
+    std::uint64_t count() const { return m_count; }
+    double mean() const { return m_mean; }
+    // Unbiased sample variance, 0 if there were less than 2 values
+    double variance() const;
+    // Standard error of the mean
+    double std_error() const;
+    Estimate estimate(double confidence) const;
+
+private:
+    std::uint64_t m_count = 0;
+    double m_mean = 0;
+    // Sum of squared deviations from the mean
+    double m_m2 = 0;
+};
+
+// Inverse of the standard normal CDF, p from (0;1)
+double normal_quantile(double p);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "level_histogram.h"
+#include "running_stats.h"
+#include "st_petersburg.h"
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+// Long run of games that can be stopped and resumed: games are played in
+// steps of `interval`, the random streams of a step are derived from the seed
+// and the index of its first game, so seed, games done and histogram are the
+// whole state. A resumed run gives the same result as an uninterrupted one.
+class Simulation
+{
+public:
+    // Seed is drawn when not set, threads are fixed at construction
+    // since for all generators but Philox the result depends on them
+    Simulation(unsigned long runs, double bankroll, const SimulationOptions & options, unsigned long interval = 100000000);
+
+    // Restores a run saved by save(), throws std::runtime_error if the checkpoint is malformed
+    static Simulation load(std::istream & in);
+    static Simulation load(const std::string & path);
+
+    void save(std::ostream & out) const;
+    // Replaces the file atomically, an interrupted save keeps the previous checkpoint
+    void save(const std::string & path) const;
+
+    // Observer of the steps with its interval, checkpoints do not keep it
+    void set_observer(std::function<bool(const Progress &)> observer, double interval);
+
+    // Plays the next interval of games, false if the run was already complete
+    // or the observer cancelled the step, a cancelled step leaves no trace
+    bool step();
+    // Plays the remaining games, saving a checkpoint to `path` after every step
+    const LevelHistogram & run(const std::string & path);
+
+    bool done() const { return m_trials_done == m_runs; }
+    unsigned long runs() const { return m_runs; }
+    unsigned long trials_done() const { return m_trials_done; }
+    unsigned long interval() const { return m_interval; }
+    const SimulationOptions & options() const { return m_options; }
+    const LevelHistogram & levels() const { return m_levels; }
+
+    Estimate estimate(double confidence = 0.95) const { return RunningStats(m_levels).estimate(confidence); }
+
+private:
+    unsigned long m_runs;
+    unsigned long m_interval;
+    unsigned long m_trials_done = 0;
+    SimulationOptions m_options;
+    LevelHistogram m_levels;
+};
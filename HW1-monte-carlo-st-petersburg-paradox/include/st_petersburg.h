@@ -1,3 +1,141 @@
 #pragma once
 
+#include "lanes.h"
+#include "level_histogram.h"
+#include "random_gen.h"
+#include "running_stats.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// Stopping rule of estimate_expected_value()
+struct Precision
+{
+    // Target half-width of the confidence interval, the run stops
+    // as soon as either the absolute or the relative one is reached.
+    // At least one must be positive
+    double absolute_error = 0;
+    double relative_error = 0;
+    // Probability that the interval covers the expected value
+    double confidence = 0.95;
+    // Games played between checks
+    unsigned long chunk = 1000000;
+    // Hard limit on the number of games
+    unsigned long max_runs = 10000000000;
+};
+
+enum class Engine
+{
+    // One uniform double per coin flip
+    Flip,
+    // Whole game from the run of tail bits in raw 64-bit words
+    Bits,
+    // LANES games at once in vector lanes with their own xoshiro256** streams,
+    // the instruction set is picked at run time, rng is not used
+    Lanes,
+    // Games surviving each level drawn at once as Binomial(survivors, 1/2),
+    // cost depends on bankroll only, runs on a single thread
+    Binomial,
+    // Quasi-Monte Carlo: a game stops at the level given by a scrambled
+    // low-discrepancy point, options.replicates independent scramblings
+    // give the error of the plain estimator, rng seeds the scrambling
+    Quasi
+};
+
+enum class Estimator
+{
+    // Average payout of independent games
+    Plain,
+    // Games split into equal strata of the uniform number that decides
+    // their level, error is measured across independent replicates
+    Stratified,
+    // Games played with a biased coin, payouts weighted by likelihood ratio
+    Importance,
+    // Games played up to hybrid_levels doublings, deeper levels added in closed form
+    Hybrid,
+    // Exact expected value, no games are played
+    Exact
+};
+
+// Snapshot of a running simulation
+struct Progress
+{
+    // Games played so far out of the requested ones
+    std::uint64_t trials = 0;
+    std::uint64_t runs = 0;
+    // Estimate from the games played so far, 95% confidence interval
+    Estimate estimate;
+    double seconds = 0;
+    double trials_per_second = 0;
+};
+
+struct SimulationOptions
+{
+    // Number of worker threads, 0 means std::thread::hardware_concurrency()
+    unsigned threads = 0;
+    // Seed of the random streams, a fresh one is drawn when not set
+    std::optional<std::uint64_t> seed;
+    // Source of random numbers
+    Rng rng = Rng::Xoshiro;
+    // Way a single game is played
+    Engine engine = Engine::Flip;
+    // Index of the first game: calls with consecutive ranges of games continue
+    // one Philox sequence, for Xoshiro the streams are reseeded from it
+    std::uint64_t first_trial = 0;
+    // Estimator used for the expected value
+    Estimator estimator = Estimator::Plain;
+    // Independent replicates of the variance-reduced estimators
+    unsigned replicates = 16;
+    // Tails probability of the importance sampling coin from (0;1), the variance-optimal one when not set
+    std::optional<double> importance_tails;
+    // Instruction set of Engine::Lanes
+    LaneIsa lane_isa = LaneIsa::Auto;
+    // Levels simulated by the hybrid estimator
+    unsigned hybrid_levels = 10;
+    // Rules of the game, the stratified, importance and hybrid estimators
+    // play the classic game only
+    GameRules rules;
+    // Called with snapshots of the plain estimator every observe_interval seconds
+    // and once at the end, from one thread at a time. Returning false stops
+    // the run early with the games played so far. Engine::Lanes reports
+    // only whole blocks of the workers, Engine::Binomial and Engine::Quasi only the end
+    std::function<bool(const Progress &)> observer;
+    double observe_interval = 1;
+};
+
 double calculate_expected_value(unsigned long runs, double bankroll);
+
+// Result is reproducible for the same seed and number of threads,
+// with Rng::Philox it is reproducible for the same seed only
+double calculate_expected_value(unsigned long runs, double bankroll, const SimulationOptions & options);
+
+// Expected value with its standard error and 95% confidence interval
+Estimate estimate_expected_value(unsigned long runs, double bankroll, const SimulationOptions & options);
+
+// Number of games per level, mean, variance and quantiles are derived from it
+LevelHistogram simulate_levels(unsigned long runs, double bankroll, const SimulationOptions & options);
+
+// One simulation of a batch
+struct BatchJob
+{
+    unsigned long runs = 0;
+    double bankroll = 0;
+};
+
+// Simulations of a batch on one pool of workers: every job is split into chunks
+// of `chunk` games and idle workers steal chunks from busy ones, so short and
+// long jobs keep every core busy. A chunk is played from streams keyed by the
+// seed and its first game, so the result does not depend on the threads and
+// jobs of a batch share their games. Engine::Binomial and Engine::Quasi jobs
+// are one chunk each, the observer is not called
+std::vector<LevelHistogram> simulate_batch(const std::vector<BatchJob> & jobs, const SimulationOptions & options, unsigned long chunk = 1UL << 18);
+
+// Estimates for several bankrolls from the same games (common random numbers):
+// every game is played once up to the largest bankroll, on the batch scheduler
+std::vector<double> calculate_expected_values(unsigned long runs, const std::vector<double> & bankrolls, const SimulationOptions & options);
+
+// Plays games in chunks until the confidence interval is narrow enough,
+// throws std::invalid_argument if precision sets no positive target
+Estimate estimate_expected_value(double bankroll, const Precision & precision, const SimulationOptions & options);
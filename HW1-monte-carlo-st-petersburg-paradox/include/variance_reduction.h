@@ -0,0 +1,37 @@
+#pragma once
+
+#include "running_stats.h"
+#include "st_petersburg.h"
+
+// Estimators behind SimulationOptions::estimator, both split the games into
+// options.replicates blocks with their own random streams, so the result does
+// not depend on the number of threads. They throw std::invalid_argument
+// for rules other than the classic game
+
+// Stratified sampling: game j of m in a replicate stops at the level decided by a
+// uniform number from [j/m; (j+1)/m), the error is measured across replicates
+Estimate estimate_stratified(unsigned long runs, double bankroll, const SimulationOptions & options, double confidence);
+
+// Importance sampling: Tails come with probability q > 1/2, so deep levels are
+// visited more often, and a payout is weighted by P_fair(level) / P_q(level)
+Estimate estimate_importance(unsigned long runs, double bankroll, const SimulationOptions & options, double confidence);
+
+// Hybrid: games are played with the engine up to options.hybrid_levels doublings,
+// the contribution of games going deeper is added exactly
+Estimate estimate_hybrid(unsigned long runs, double bankroll, const SimulationOptions & options, double confidence);
+
+// Quasi-Monte Carlo behind Engine::Quasi: every replicate maps its own scrambled
+// van der Corput points to levels, the error is measured across replicates.
+// Any rules are supported
+LevelHistogram quasi_levels(unsigned long runs, double bankroll, const SimulationOptions & options);
+Estimate estimate_quasi(unsigned long runs, double bankroll, const SimulationOptions & options, double confidence);
+
+// Expected payout of the fair game, sum of P(level) * payout(level)
+double exact_expected_value(double bankroll);
+double exact_expected_value(double bankroll, const GameRules & rules);
+
+// Variance of a single payout of the fair game
+double payout_variance(double bankroll);
+
+// Tails probability q minimizing the variance of the importance sampling estimator
+double optimal_importance_tails(double bankroll);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "parallel.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Tasks [0; tasks) split into one contiguous range per worker. A worker takes
+// tasks from the front of its own range and, once it is empty, steals the back
+// half of the range of another worker. Both ends of a range live in one atomic
+// word, so taking and stealing are single compare-and-swaps. A range only ever
+// holds tasks nobody has taken, so a stale view of it can not match again.
+class StealingRanges
+{
+public:
+    StealingRanges(const std::uint32_t tasks, const unsigned workers)
+        : m_ranges(workers)
+    {
+        for (unsigned i = 0; i < workers; ++i) {
+            const auto begin = static_cast<std::uint32_t>(part_begin(tasks, workers, i));
+            m_ranges[i].bounds.store(pack(begin, begin + static_cast<std::uint32_t>(part_size(tasks, workers, i))), std::memory_order_relaxed);
+        }
+    }
+
+    // Next task of `worker`, false once no range has tasks left
+    bool next(const unsigned worker, std::uint32_t & task)
+    {
+        auto & own = m_ranges[worker].bounds;
+        std::uint64_t bounds = own.load(std::memory_order_acquire);
+        while (begin(bounds) < end(bounds)) {
+            if (own.compare_exchange_weak(bounds, pack(begin(bounds) + 1, end(bounds)), std::memory_order_acq_rel)) {
+                task = begin(bounds);
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < m_ranges.size(); ++i) {
+            auto & victim = m_ranges[(worker + i) % m_ranges.size()].bounds;
+            bounds = victim.load(std::memory_order_acquire);
+            while (begin(bounds) < end(bounds)) {
+                const std::uint32_t half = (end(bounds) - begin(bounds) + 1) / 2;
+                if (victim.compare_exchange_weak(bounds, pack(begin(bounds), end(bounds) - half), std::memory_order_acq_rel)) {
+                    // First stolen task is played now, the rest becomes our range
+                    task = end(bounds) - half;
+                    own.store(pack(task + 1, end(bounds)), std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    static std::uint64_t pack(const std::uint32_t begin, const std::uint32_t end) { return std::uint64_t{begin} << 32 | end; }
+    static std::uint32_t begin(const std::uint64_t bounds) { return static_cast<std::uint32_t>(bounds >> 32); }
+    static std::uint32_t end(const std::uint64_t bounds) { return static_cast<std::uint32_t>(bounds); }
+
+    // Own cache line each: ranges are written by their owners all the time
+    struct alignas(64) Range
+    {
+        std::atomic<std::uint64_t> bounds{0};
+    };
+
+    std::vector<Range> m_ranges;
+};
+
+// Calls work(task) for every task in [0; tasks) on `threads` workers that steal from each other
+template <class Work>
+void run_stealing(const std::uint32_t tasks, const unsigned threads, const Work & work)
+{
+    StealingRanges ranges(tasks, threads);
+    run_workers(threads, [&](const unsigned index) {
+        std::uint32_t task;
+        while (ranges.next(index, task)) {
+            work(task);
+        }
+    });
+}
@@ -0,0 +1,73 @@
+#include "st_petersburg.h"
+
+#include "work_stealing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+
+namespace {
+
+// Games of one job played by one worker at once
+struct Chunk
+{
+    std::size_t job;
+    std::uint64_t first;
+    unsigned long count;
+};
+
+} // anonymous namespace
+
+std::vector<LevelHistogram> simulate_batch(const std::vector<BatchJob> & jobs, const SimulationOptions & options, unsigned long chunk)
+{
+    SimulationOptions chunk_options = options;
+    chunk_options.seed = options.seed ? *options.seed : make_random_seed();
+    chunk_options.threads = 1;
+    chunk_options.observer = nullptr;
+
+    // Chunk indices must fit the 32-bit ends of the stealing ranges
+    unsigned long longest = 0;
+    for (const auto & job : jobs) {
+        longest = std::max(longest, job.runs);
+    }
+    chunk = std::max({chunk, 1UL, longest / (std::numeric_limits<std::uint32_t>::max() / std::max<std::size_t>(jobs.size(), 1)) + 1});
+
+    std::vector<Chunk> chunks;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        // The aggregate engines play a job at a cost that does not grow with its runs
+        const bool whole = options.engine == Engine::Quasi || options.engine == Engine::Binomial;
+        const unsigned long size = whole ? std::max(jobs[i].runs, 1UL) : chunk;
+        for (unsigned long first = 0; first < jobs[i].runs; first += size) {
+            chunks.push_back({i, first, std::min(size, jobs[i].runs - first)});
+        }
+    }
+
+    // Workers add their counts as they go, no lock and no per-worker copies
+    std::vector<std::unique_ptr<std::atomic<std::uint64_t>[]>> counts;
+    std::vector<LevelHistogram> result;
+    for (const auto & job : jobs) {
+        result.emplace_back(job.bankroll, options.rules);
+        counts.emplace_back(new std::atomic<std::uint64_t>[result.back().counts().size()]());
+    }
+
+    const unsigned threads = resolve_threads(chunks.size(), options.threads);
+    run_stealing(static_cast<std::uint32_t>(chunks.size()), threads, [&](const std::uint32_t task) {
+        const Chunk & piece = chunks[task];
+        SimulationOptions own = chunk_options;
+        own.first_trial = options.first_trial + piece.first;
+        const LevelHistogram played = simulate_levels(piece.count, jobs[piece.job].bankroll, own);
+        for (unsigned level = 0; level <= played.level_cap(); ++level) {
+            if (played.counts()[level] != 0) {
+                counts[piece.job][level].fetch_add(played.counts()[level], std::memory_order_relaxed);
+            }
+        }
+    });
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        for (unsigned level = 0; level <= result[i].level_cap(); ++level) {
+            result[i].add(level, counts[i][level].load(std::memory_order_relaxed));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,66 @@
+#include "distribution_report.h"
+
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+DistributionReport make_distribution_report(const LevelHistogram & levels)
+{
+    DistributionReport report;
+    report.bankroll = levels.bankroll();
+    report.runs = levels.runs();
+    report.mean = levels.mean();
+    report.std_dev = std::sqrt(levels.variance());
+    report.std_error = report.runs == 0 ? 0 : report.std_dev / std::sqrt(static_cast<double>(report.runs));
+    report.median = levels.quantile(0.5);
+    report.p99 = levels.quantile(0.99);
+    report.p999 = levels.quantile(0.999);
+    if (report.runs > 0) {
+        const double p = static_cast<double>(levels.counts()[levels.level_cap()]) / static_cast<double>(report.runs);
+        report.cap_probability = p;
+        report.cap_probability_error = std::sqrt(p * (1 - p) / static_cast<double>(report.runs));
+    }
+    for (unsigned level = 0; level <= levels.level_cap(); ++level) {
+        report.levels.push_back({level, levels.payout(level), levels.counts()[level]});
+    }
+    return report;
+}
+
+DistributionReport distribution_report(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+{
+    return make_distribution_report(simulate_levels(runs, bankroll, options));
+}
+
+void write_report_csv(std::ostream & out, const DistributionReport & report)
+{
+    const auto precision = out.precision(10);
+    out << "bankroll,runs,mean,std_error,std_dev,median,p99,p999,cap_probability,cap_probability_error\n"
+        << report.bankroll << ',' << report.runs << ',' << report.mean << ',' << report.std_error << ','
+        << report.std_dev << ',' << report.median << ',' << report.p99 << ',' << report.p999 << ','
+        << report.cap_probability << ',' << report.cap_probability_error << '\n';
+    out.precision(precision);
+}
+
+void write_report_json(std::ostream & out, const DistributionReport & report)
+{
+    const auto precision = out.precision(10);
+    out << "{\n"
+        << "  \"bankroll\": " << report.bankroll << ",\n"
+        << "  \"runs\": " << report.runs << ",\n"
+        << "  \"mean\": " << report.mean << ",\n"
+        << "  \"std_error\": " << report.std_error << ",\n"
+        << "  \"std_dev\": " << report.std_dev << ",\n"
+        << "  \"median\": " << report.median << ",\n"
+        << "  \"p99\": " << report.p99 << ",\n"
+        << "  \"p999\": " << report.p999 << ",\n"
+        << "  \"cap_probability\": " << report.cap_probability << ",\n"
+        << "  \"cap_probability_error\": " << report.cap_probability_error << ",\n"
+        << "  \"levels\": [";
+    for (std::size_t i = 0; i < report.levels.size(); ++i) {
+        const auto & level = report.levels[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"level\": " << level.level << ", \"payout\": " << level.payout
+            << ", \"count\": " << level.count << "}";
+    }
+    out << "\n  ]\n}\n";
+    out.precision(precision);
+}
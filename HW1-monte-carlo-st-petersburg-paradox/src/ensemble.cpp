@@ -0,0 +1,117 @@
+#include "ensemble.h"
+
+#include "random_gen.h"
+#include "work_stealing.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Histories of one block, advanced one game at a time in lockstep
+constexpr unsigned BLOCK = 256;
+
+// What a block leaves behind, each block writes only its own
+struct BlockResult
+{
+    std::vector<std::uint64_t> ruin_times;
+    std::uint64_t survivors = 0;
+    double final_capital = 0;
+};
+
+template <class Generator>
+void play_block(Generator & rnd, const unsigned lanes, const CasinoModel & model, const std::vector<double> & payouts, const double log_tails, BlockResult & result)
+{
+    const unsigned limit = static_cast<unsigned>(payouts.size() - 1);
+    // Struct of arrays: one plain array per field, the game loop runs over lanes
+    std::array<double, BLOCK> capital;
+    std::array<std::uint64_t, BLOCK> ruin_time{};
+    std::array<double, BLOCK> u;
+    capital.fill(model.capital);
+
+    unsigned alive = lanes;
+    for (std::uint64_t game = 1; game <= model.max_games && alive > 0; ++game) {
+        // Ruined lanes draw too, so that every lane keeps its place in the stream
+        rnd.fill(u.data(), lanes);
+        unsigned ruined = 0;
+        for (unsigned i = 0; i < lanes; ++i) {
+            const double win = payouts[geometric_tails(u[i], log_tails, limit)];
+            const double available = capital[i] + model.fee;
+            const bool playing = ruin_time[i] == 0;
+            const bool ruin = playing && win > available;
+            capital[i] = playing ? (ruin ? 0 : available - win) : capital[i];
+            ruin_time[i] = ruin ? game : ruin_time[i];
+            ruined += ruin ? 1 : 0;
+        }
+        alive -= ruined;
+    }
+
+    for (unsigned i = 0; i < lanes; ++i) {
+        if (ruin_time[i] != 0) {
+            result.ruin_times.push_back(ruin_time[i]);
+        }
+        else {
+            ++result.survivors;
+            result.final_capital += capital[i];
+        }
+    }
+}
+
+} // anonymous namespace
+
+std::uint64_t EnsembleResult::ruin_time_quantile(const double p) const
+{
+    if (ruin_times.empty()) {
+        return 0;
+    }
+    const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(ruin_times.size())));
+    return ruin_times[std::min(std::max<std::size_t>(rank, 1), ruin_times.size()) - 1];
+}
+
+EnsembleResult simulate_ensemble(const unsigned long histories, const CasinoModel & model, const SimulationOptions & options)
+{
+    options.rules.validate();
+    const std::uint64_t seed = options.seed ? *options.seed : make_random_seed();
+
+    // Win of every level, the bankroll of the moment caps it in the game loop
+    const unsigned limit = max_level(std::numeric_limits<double>::infinity(), options.rules);
+    std::vector<double> payouts(limit + 1);
+    for (unsigned level = 0; level <= limit; ++level) {
+        payouts[level] = options.rules.initial_bet * std::pow(options.rules.multiplier, level);
+    }
+    const double log_tails = std::log(options.rules.tails_probability);
+
+    const auto blocks = static_cast<std::uint32_t>((histories + BLOCK - 1) / BLOCK);
+    std::vector<BlockResult> results(blocks);
+    run_stealing(blocks, resolve_threads(blocks, options.threads), [&](const std::uint32_t block) {
+        const unsigned lanes = static_cast<unsigned>(std::min<unsigned long>(BLOCK, histories - std::uint64_t{block} * BLOCK));
+        // Blocks get split seeds: stream `block` of xoshiro256** takes `block` jumps to reach
+        if (options.rng == Rng::Philox) {
+            Philox4x32 rnd(seed, block);
+            play_block(rnd, lanes, model, payouts, log_tails, results[block]);
+        }
+        else {
+            with_generator(options.rng, mix_seed(seed, block), 0, [&](auto & rnd) {
+                play_block(rnd, lanes, model, payouts, log_tails, results[block]);
+            });
+        }
+    });
+
+    EnsembleResult result;
+    result.histories = histories;
+    std::uint64_t survivors = 0;
+    double final_capital = 0;
+    for (const auto & block : results) {
+        result.ruin_times.insert(result.ruin_times.end(), block.ruin_times.begin(), block.ruin_times.end());
+        survivors += block.survivors;
+        final_capital += block.final_capital;
+    }
+    std::sort(result.ruin_times.begin(), result.ruin_times.end());
+    const double n = static_cast<double>(histories);
+    const double p = histories > 0 ? static_cast<double>(result.ruin_times.size()) / n : 0;
+    result.ruin_probability = make_estimate(p, histories > 0 ? std::sqrt(p * (1 - p) / n) : 0, histories, 0.95);
+    result.mean_final_capital = survivors > 0 ? final_capital / static_cast<double>(survivors) : 0;
+    return result;
+}
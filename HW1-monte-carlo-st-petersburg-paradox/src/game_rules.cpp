@@ -0,0 +1,33 @@
+#include "game_rules.h"
+
+#include <stdexcept>
+#include <string>
+
+bool GameRules::standard() const
+{
+    return *this == GameRules{};
+}
+
+void GameRules::validate() const
+{
+    if (!(initial_bet > 0) || !(multiplier > 0)) {
+        throw std::invalid_argument("Initial bet and multiplier must be positive");
+    }
+    if (!(tails_probability >= 0 && tails_probability < 1)) {
+        throw std::invalid_argument("Tails probability must be from [0;1)");
+    }
+    if (cap == CapPolicy::Rounds && max_rounds > LEVEL_LIMIT) {
+        throw std::invalid_argument("Max rounds must be at most " + std::to_string(LEVEL_LIMIT));
+    }
+    if (cap == CapPolicy::Bankroll && !(multiplier > 1)) {
+        // The win never reaches the bankroll
+        throw std::invalid_argument("Multiplier must be above 1 when the bankroll caps the game");
+    }
+}
+
+bool operator==(const GameRules & lhs, const GameRules & rhs)
+{
+    return lhs.initial_bet == rhs.initial_bet && lhs.multiplier == rhs.multiplier &&
+           lhs.tails_probability == rhs.tails_probability && lhs.cap == rhs.cap &&
+           (lhs.cap != CapPolicy::Rounds || lhs.max_rounds == rhs.max_rounds);
+}
@@ -0,0 +1,176 @@
+#include "lanes.h"
+#include "lane_kernel.h"
+#include "parallel.h"
+#include "random_gen.h"
+
+#include <vector>
+
+void play_lanes_avx2(const std::uint64_t (&state)[4][LANES], const std::uint64_t (&quota)[LANES], unsigned level_cap, std::uint64_t * lane_counts, std::uint64_t * counts);
+void play_lanes_avx512(const std::uint64_t (&state)[4][LANES], const std::uint64_t (&quota)[LANES], unsigned level_cap, std::uint64_t * lane_counts, std::uint64_t * counts);
+
+namespace {
+
+// Plain arrays, the compiler is free to vectorize the loops
+struct ScalarVec
+{
+    std::uint64_t v[LANES];
+
+    static ScalarVec set1(const std::uint64_t x)
+    {
+        ScalarVec r;
+        for (auto & lane : r.v) {
+            lane = x;
+        }
+        return r;
+    }
+    static ScalarVec load(const std::uint64_t * p)
+    {
+        ScalarVec r;
+        for (unsigned i = 0; i < LANES; ++i) {
+            r.v[i] = p[i];
+        }
+        return r;
+    }
+    static void store(std::uint64_t * p, const ScalarVec & a)
+    {
+        for (unsigned i = 0; i < LANES; ++i) {
+            p[i] = a.v[i];
+        }
+    }
+    template <class Op>
+    static ScalarVec map(const ScalarVec & a, const ScalarVec & b, const Op & op)
+    {
+        ScalarVec r;
+        for (unsigned i = 0; i < LANES; ++i) {
+            r.v[i] = op(a.v[i], b.v[i]);
+        }
+        return r;
+    }
+    static ScalarVec add(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return x + y; });
+    }
+    static ScalarVec sub(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return x - y; });
+    }
+    static ScalarVec bit_and(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return x & y; });
+    }
+    // ~a & b
+    static ScalarVec bit_andnot(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return ~x & y; });
+    }
+    static ScalarVec bit_or(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return x | y; });
+    }
+    static ScalarVec bit_xor(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return x ^ y; });
+    }
+    template <int N>
+    static ScalarVec shl(const ScalarVec & a)
+    {
+        return map(a, a, [](const std::uint64_t x, std::uint64_t) { return x << N; });
+    }
+    template <int N>
+    static ScalarVec shr(const ScalarVec & a)
+    {
+        return map(a, a, [](const std::uint64_t x, std::uint64_t) { return x >> N; });
+    }
+    static ScalarVec cmpeq(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return x == y ? ~std::uint64_t{0} : 0; });
+    }
+    static ScalarVec cmpgt(const ScalarVec & a, const ScalarVec & b)
+    {
+        return map(a, b, [](const std::uint64_t x, const std::uint64_t y) { return x > y ? ~std::uint64_t{0} : 0; });
+    }
+    static unsigned movemask(const ScalarVec & a)
+    {
+        unsigned r = 0;
+        for (unsigned i = 0; i < LANES; ++i) {
+            r |= static_cast<unsigned>(a.v[i] >> 63) << i;
+        }
+        return r;
+    }
+};
+
+} // anonymous namespace
+
+bool lane_isa_supported(const LaneIsa isa)
+{
+    switch (isa) {
+    case LaneIsa::Auto:
+    case LaneIsa::Scalar:
+        return true;
+    case LaneIsa::Avx2:
+#ifdef HAVE_LANES_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    case LaneIsa::Avx512:
+#ifdef HAVE_LANES_AVX512
+        return __builtin_cpu_supports("avx512f");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+LaneIsa detect_lane_isa()
+{
+    for (const auto isa : {LaneIsa::Avx512, LaneIsa::Avx2}) {
+        if (lane_isa_supported(isa)) {
+            return isa;
+        }
+    }
+    return LaneIsa::Scalar;
+}
+
+void play_lanes(const unsigned long games, const std::uint64_t seed, const std::uint64_t first_stream, LaneIsa isa, LevelHistogram & levels)
+{
+    if (isa == LaneIsa::Auto || !lane_isa_supported(isa)) {
+        isa = detect_lane_isa();
+    }
+
+    // Lane l continues stream first_stream + l, transposed for vector loads
+    std::uint64_t state[4][LANES];
+    std::uint64_t quota[LANES];
+    auto rnd = Xoshiro256::stream(seed, first_stream);
+    for (unsigned lane = 0; lane < LANES; ++lane) {
+        const auto words = rnd.state();
+        for (unsigned i = 0; i < 4; ++i) {
+            state[i][lane] = words[i];
+        }
+        quota[lane] = part_size(games, LANES, lane);
+        rnd.jump();
+    }
+
+    // Buffers live here, the kernels of other instruction sets must not allocate
+    std::vector<std::uint64_t> lane_counts(std::size_t{LANES} * (levels.level_cap() + 1), 0);
+    std::vector<std::uint64_t> counts(levels.level_cap() + 1, 0);
+    switch (isa) {
+#ifdef HAVE_LANES_AVX512
+    case LaneIsa::Avx512:
+        play_lanes_avx512(state, quota, levels.level_cap(), lane_counts.data(), counts.data());
+        break;
+#endif
+#ifdef HAVE_LANES_AVX2
+    case LaneIsa::Avx2:
+        play_lanes_avx2(state, quota, levels.level_cap(), lane_counts.data(), counts.data());
+        break;
+#endif
+    default:
+        play_lanes_kernel<ScalarVec>(state, quota, levels.level_cap(), lane_counts.data(), counts.data());
+        break;
+    }
+    for (unsigned level = 0; level < counts.size(); ++level) {
+        levels.add(level, counts[level]);
+    }
+}
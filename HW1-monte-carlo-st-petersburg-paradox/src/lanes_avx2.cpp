@@ -0,0 +1,58 @@
+// Compiled with -mavx2 and called only after a runtime CPU check
+#ifdef __AVX2__
+
+#include "lane_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+// Two 256-bit registers of 4 lanes each
+struct Avx2Vec
+{
+    __m256i lo;
+    __m256i hi;
+
+    static Avx2Vec set1(const std::uint64_t x)
+    {
+        const __m256i v = _mm256_set1_epi64x(static_cast<long long>(x));
+        return {v, v};
+    }
+    static Avx2Vec load(const std::uint64_t * p)
+    {
+        return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 4))};
+    }
+    static void store(std::uint64_t * p, const Avx2Vec & a)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a.lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + 4), a.hi);
+    }
+    static Avx2Vec add(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_add_epi64(a.lo, b.lo), _mm256_add_epi64(a.hi, b.hi)}; }
+    static Avx2Vec sub(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_sub_epi64(a.lo, b.lo), _mm256_sub_epi64(a.hi, b.hi)}; }
+    static Avx2Vec bit_and(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_and_si256(a.lo, b.lo), _mm256_and_si256(a.hi, b.hi)}; }
+    static Avx2Vec bit_andnot(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_andnot_si256(a.lo, b.lo), _mm256_andnot_si256(a.hi, b.hi)}; }
+    static Avx2Vec bit_or(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_or_si256(a.lo, b.lo), _mm256_or_si256(a.hi, b.hi)}; }
+    static Avx2Vec bit_xor(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_xor_si256(a.lo, b.lo), _mm256_xor_si256(a.hi, b.hi)}; }
+    template <int N>
+    static Avx2Vec shl(const Avx2Vec & a) { return {_mm256_slli_epi64(a.lo, N), _mm256_slli_epi64(a.hi, N)}; }
+    template <int N>
+    static Avx2Vec shr(const Avx2Vec & a) { return {_mm256_srli_epi64(a.lo, N), _mm256_srli_epi64(a.hi, N)}; }
+    static Avx2Vec cmpeq(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_cmpeq_epi64(a.lo, b.lo), _mm256_cmpeq_epi64(a.hi, b.hi)}; }
+    // Signed compare, levels and game counts stay far below 2^63
+    static Avx2Vec cmpgt(const Avx2Vec & a, const Avx2Vec & b) { return {_mm256_cmpgt_epi64(a.lo, b.lo), _mm256_cmpgt_epi64(a.hi, b.hi)}; }
+    static unsigned movemask(const Avx2Vec & a)
+    {
+        const int lo = _mm256_movemask_pd(_mm256_castsi256_pd(a.lo));
+        const int hi = _mm256_movemask_pd(_mm256_castsi256_pd(a.hi));
+        return static_cast<unsigned>(lo | (hi << 4));
+    }
+};
+
+} // anonymous namespace
+
+void play_lanes_avx2(const std::uint64_t (&state)[4][LANES], const std::uint64_t (&quota)[LANES], const unsigned level_cap, std::uint64_t * lane_counts, std::uint64_t * counts)
+{
+    play_lanes_kernel<Avx2Vec>(state, quota, level_cap, lane_counts, counts);
+}
+
+#endif
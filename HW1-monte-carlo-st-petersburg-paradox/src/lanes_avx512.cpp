@@ -0,0 +1,41 @@
+// Compiled with -mavx512f and called only after a runtime CPU check
+#ifdef __AVX512F__
+
+#include "lane_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+// One 512-bit register, comparisons expand the mask registers back to lanes
+struct Avx512Vec
+{
+    __m512i v;
+
+    static Avx512Vec set1(const std::uint64_t x) { return {_mm512_set1_epi64(static_cast<long long>(x))}; }
+    static Avx512Vec load(const std::uint64_t * p) { return {_mm512_loadu_si512(p)}; }
+    static void store(std::uint64_t * p, const Avx512Vec & a) { _mm512_storeu_si512(p, a.v); }
+    static Avx512Vec add(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_add_epi64(a.v, b.v)}; }
+    static Avx512Vec sub(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_sub_epi64(a.v, b.v)}; }
+    static Avx512Vec bit_and(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_and_si512(a.v, b.v)}; }
+    // Zero-masked forms: the unmasked ones trip -Wmaybe-uninitialized in GCC 12 headers
+    static Avx512Vec bit_andnot(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_maskz_andnot_epi64(0xFF, a.v, b.v)}; }
+    static Avx512Vec bit_or(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_or_si512(a.v, b.v)}; }
+    static Avx512Vec bit_xor(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_xor_si512(a.v, b.v)}; }
+    template <int N>
+    static Avx512Vec shl(const Avx512Vec & a) { return {_mm512_maskz_slli_epi64(0xFF, a.v, N)}; }
+    template <int N>
+    static Avx512Vec shr(const Avx512Vec & a) { return {_mm512_maskz_srli_epi64(0xFF, a.v, N)}; }
+    static Avx512Vec cmpeq(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_maskz_set1_epi64(_mm512_cmpeq_epu64_mask(a.v, b.v), -1)}; }
+    static Avx512Vec cmpgt(const Avx512Vec & a, const Avx512Vec & b) { return {_mm512_maskz_set1_epi64(_mm512_cmpgt_epu64_mask(a.v, b.v), -1)}; }
+    static unsigned movemask(const Avx512Vec & a) { return _mm512_test_epi64_mask(a.v, a.v); }
+};
+
+} // anonymous namespace
+
+void play_lanes_avx512(const std::uint64_t (&state)[4][LANES], const std::uint64_t (&quota)[LANES], const unsigned level_cap, std::uint64_t * lane_counts, std::uint64_t * counts)
+{
+    play_lanes_kernel<Avx512Vec>(state, quota, level_cap, lane_counts, counts);
+}
+
+#endif
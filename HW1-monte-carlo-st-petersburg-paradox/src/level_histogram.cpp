@@ -0,0 +1,145 @@
+#include "level_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+unsigned max_level(const double bankroll)
+{
+    return max_level(bankroll, GameRules{});
+}
+
+unsigned max_level(const double bankroll, const GameRules & rules)
+{
+    if (rules.cap == CapPolicy::Rounds) {
+        return std::min(rules.max_rounds, LEVEL_LIMIT);
+    }
+    if (rules.initial_bet == 2 && rules.multiplier == 2 && bankroll > 0 && std::isfinite(bankroll)) {
+        // Smallest k with 2 << k >= bankroll from the binary exponent, no repeated doubling
+        int exponent;
+        const double fraction = std::frexp(bankroll, &exponent);
+        const int level = fraction == 0.5 ? exponent - 2 : exponent - 1;
+        return static_cast<unsigned>(std::clamp(level, 0, static_cast<int>(LEVEL_LIMIT)));
+    }
+    unsigned level = 0;
+    long double current_win = rules.initial_bet;
+    while (current_win < bankroll && level < LEVEL_LIMIT) {
+        current_win *= rules.multiplier;
+        ++level;
+    }
+    return level;
+}
+
+double level_probability(const unsigned level, const unsigned level_cap, const double tails_probability)
+{
+    if (level > level_cap) {
+        return 0;
+    }
+    if (tails_probability == 0.5) {
+        // Heads after `level` Tails, or just `level` Tails at the cap
+        return std::ldexp(1.0, -static_cast<int>(level < level_cap ? level + 1 : level));
+    }
+    return std::pow(tails_probability, level) * (level < level_cap ? 1 - tails_probability : 1);
+}
+
+LevelHistogram::LevelHistogram(const double bankroll, const GameRules & rules)
+    : m_bankroll(bankroll)
+    , m_rules(rules)
+    , m_counts(max_level(bankroll, rules) + 1, 0)
+{
+    rules.validate();
+}
+
+void LevelHistogram::add(const unsigned level, const std::uint64_t count)
+{
+    m_counts[level] += count;
+}
+
+void LevelHistogram::merge(const LevelHistogram & other)
+{
+    if (other.m_bankroll != m_bankroll || other.m_counts.size() != m_counts.size() || other.m_rules != m_rules) {
+        throw std::invalid_argument("Histograms of different bankrolls or rules can not be merged");
+    }
+    for (std::size_t i = 0; i < m_counts.size(); ++i) {
+        m_counts[i] += other.m_counts[i];
+    }
+}
+
+std::uint64_t LevelHistogram::runs() const
+{
+    std::uint64_t result = 0;
+    for (const auto count : m_counts) {
+        result += count;
+    }
+    return result;
+}
+
+double LevelHistogram::payout(const unsigned level) const
+{
+    if (m_rules.standard()) {
+        const double current_win = level < 63 ? static_cast<double>(std::uint64_t{2} << level) : std::ldexp(2.0, static_cast<int>(level));
+        // Bound winnings by bankroll
+        return current_win > m_bankroll ? m_bankroll : current_win;
+    }
+    const double current_win = m_rules.initial_bet * std::pow(m_rules.multiplier, level);
+    return m_rules.cap == CapPolicy::Bankroll && current_win > m_bankroll ? m_bankroll : current_win;
+}
+
+LevelHistogram LevelHistogram::with_bankroll(const double bankroll) const
+{
+    if (bankroll > m_bankroll) {
+        throw std::invalid_argument("Games stopped at the bankroll can not be replayed for a larger one");
+    }
+    LevelHistogram result(bankroll, m_rules);
+    for (unsigned level = 0; level < m_counts.size(); ++level) {
+        result.add(std::min(level, result.level_cap()), m_counts[level]);
+    }
+    return result;
+}
+
+double LevelHistogram::mean() const
+{
+    const std::uint64_t n = runs();
+    if (n == 0) {
+        return 0;
+    }
+    long double sum = 0;
+    for (unsigned level = 0; level < m_counts.size(); ++level) {
+        sum += static_cast<long double>(payout(level)) * m_counts[level];
+    }
+    return static_cast<double>(sum / n);
+}
+
+double LevelHistogram::variance() const
+{
+    const std::uint64_t n = runs();
+    if (n < 2) {
+        return 0;
+    }
+    // Second pass around the mean keeps small variances accurate
+    const long double m = mean();
+    long double sum = 0;
+    for (unsigned level = 0; level < m_counts.size(); ++level) {
+        const long double delta = payout(level) - m;
+        sum += delta * delta * m_counts[level];
+    }
+    return static_cast<double>(sum / (n - 1));
+}
+
+double LevelHistogram::quantile(const double p) const
+{
+    const std::uint64_t n = runs();
+    if (n == 0) {
+        return 0;
+    }
+    // Games needed below or at the answer, at least one
+    const auto target = std::max<long double>(std::ceil(static_cast<long double>(std::clamp(p, 0.0, 1.0)) * n), 1);
+    std::uint64_t seen = 0;
+    for (unsigned level = 0; level < m_counts.size(); ++level) {
+        seen += m_counts[level];
+        if (seen >= target) {
+            return payout(level);
+        }
+    }
+    return payout(level_cap());
+}
@@ -1,17 +1,445 @@
+#include "distribution_report.h"
+#include "partial_result.h"
+#include "query_server.h"
+#include "result_cache.h"
+#include "simulation.h"
 #include "st_petersburg.h"
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
+namespace {
+
+std::optional<Rng> parse_rng(const std::string & name)
+{
+    if (name == "xoshiro") {
+        return Rng::Xoshiro;
+    }
+    if (name == "philox") {
+        return Rng::Philox;
+    }
+    if (name == "pcg64") {
+        return Rng::Pcg64;
+    }
+    if (name == "mt19937") {
+        return Rng::Mt19937;
+    }
+    return std::nullopt;
+}
+
+std::optional<Engine> parse_engine(const std::string & name)
+{
+    if (name == "flip") {
+        return Engine::Flip;
+    }
+    if (name == "bits") {
+        return Engine::Bits;
+    }
+    if (name == "lanes") {
+        return Engine::Lanes;
+    }
+    if (name == "binomial") {
+        return Engine::Binomial;
+    }
+    if (name == "quasi") {
+        return Engine::Quasi;
+    }
+    return std::nullopt;
+}
+
+// Applies one --name=value option, false if it is unknown or malformed
+bool parse_option(const std::string & arg, SimulationOptions & options)
+{
+    const auto eq = arg.find('=');
+    if (eq == std::string::npos) {
+        return false;
+    }
+    const std::string name = arg.substr(2, eq - 2);
+    const std::string value = arg.substr(eq + 1);
+    if (name == "rng") {
+        const auto rng = parse_rng(value);
+        options.rng = rng.value_or(options.rng);
+        return rng.has_value();
+    }
+    if (name == "engine") {
+        const auto engine = parse_engine(value);
+        options.engine = engine.value_or(options.engine);
+        return engine.has_value();
+    }
+    if (name == "seed") {
+        options.seed = std::stoull(value);
+        return true;
+    }
+    if (name == "threads") {
+        options.threads = static_cast<unsigned>(std::stoul(value));
+        return true;
+    }
+    if (name == "first-trial") {
+        options.first_trial = std::stoull(value);
+        return true;
+    }
+    if (name == "bet") {
+        options.rules.initial_bet = std::stod(value);
+        return true;
+    }
+    if (name == "multiplier") {
+        options.rules.multiplier = std::stod(value);
+        return true;
+    }
+    if (name == "tails") {
+        options.rules.tails_probability = std::stod(value);
+        return true;
+    }
+    if (name == "max-rounds") {
+        options.rules.cap = CapPolicy::Rounds;
+        options.rules.max_rounds = static_cast<unsigned>(std::stoul(value));
+        return true;
+    }
+    return false;
+}
+
+void print_estimate(const Estimate & estimate)
+{
+    std::cout << estimate.mean << " +- " << estimate.std_error
+              << " (95% CI [" << estimate.low << "; " << estimate.high << "], "
+              << estimate.runs << " games)" << std::endl;
+}
+
+// merge [--output=FILE] FILE...
+int merge_main(const std::vector<std::string> & args)
+{
+    std::string output;
+    std::vector<PartialResult> results;
+    try {
+        for (const auto & arg : args) {
+            if (arg.rfind("--output=", 0) == 0) {
+                output = arg.substr(arg.find('=') + 1);
+                continue;
+            }
+            results.push_back(read_partial_result(arg));
+        }
+        if (results.empty()) {
+            std::cerr << "No partial results to merge" << std::endl;
+            return 1;
+        }
+        const PartialResult merged = merge_partial_results(results);
+        if (!output.empty()) {
+            write_partial_result(output, merged);
+        }
+        print_estimate(merged.moments.estimate(0.95));
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// serve --socket=PATH [--threads=N] [--chunk=N]
+int serve_main(const std::vector<std::string> & args)
+{
+    std::string socket;
+    unsigned threads = 0;
+    unsigned long chunk = 1UL << 20;
+    try {
+        for (const auto & arg : args) {
+            const std::string value = arg.substr(arg.find('=') + 1);
+            if (arg.rfind("--socket=", 0) == 0) {
+                socket = value;
+            }
+            else if (arg.rfind("--threads=", 0) == 0) {
+                threads = static_cast<unsigned>(std::stoul(value));
+            }
+            else if (arg.rfind("--chunk=", 0) == 0) {
+                chunk = std::stoul(value);
+            }
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return 1;
+            }
+        }
+        if (socket.empty()) {
+            std::cerr << "No socket to serve on" << std::endl;
+            return 1;
+        }
+        QueryServer server(socket, threads, chunk);
+        std::cerr << "Serving on " << socket << " with " << server.threads() << " workers" << std::endl;
+        server.run();
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// load --socket=PATH [--clients=N] [--requests=N] [--error=X] [--rng=NAME] [--engine=NAME] [runs [bankroll]]
+// Every client sends its queries one after another with seeds of its own
+int load_main(const std::vector<std::string> & args)
+{
+    std::string socket;
+    unsigned clients = 4;
+    unsigned requests = 100;
+    Query query;
+    query.runs = 100000;
+    try {
+        SimulationOptions options;
+        int positional = 0;
+        for (const auto & arg : args) {
+            const std::string value = arg.substr(arg.find('=') + 1);
+            if (arg.rfind("--socket=", 0) == 0) {
+                socket = value;
+            }
+            else if (arg.rfind("--clients=", 0) == 0) {
+                clients = std::max(static_cast<unsigned>(std::stoul(value)), 1U);
+            }
+            else if (arg.rfind("--requests=", 0) == 0) {
+                requests = static_cast<unsigned>(std::stoul(value));
+            }
+            else if (arg.rfind("--error=", 0) == 0) {
+                query.relative_error = std::stod(value);
+            }
+            else if (arg.rfind("--rng=", 0) == 0 || arg.rfind("--engine=", 0) == 0) {
+                if (!parse_option(arg, options)) {
+                    std::cerr << "Unknown option " << arg << std::endl;
+                    return 1;
+                }
+            }
+            else if (positional == 0 && arg.rfind("--", 0) != 0) {
+                query.runs = std::stoul(arg);
+                ++positional;
+            }
+            else if (positional == 1 && arg.rfind("--", 0) != 0) {
+                query.bankroll = std::stod(arg);
+                ++positional;
+            }
+            else {
+                std::cerr << "Unexpected argument " << arg << std::endl;
+                return 1;
+            }
+        }
+        if (socket.empty()) {
+            std::cerr << "No socket to connect to" << std::endl;
+            return 1;
+        }
+        query.engine = options.engine;
+        query.rng = options.rng;
+
+        using Clock = std::chrono::steady_clock;
+        std::vector<std::vector<double>> latencies(clients);
+        std::vector<std::uint64_t> games(clients, 0);
+        std::vector<std::string> errors(clients);
+        const auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned client = 0; client < clients; ++client) {
+            threads.emplace_back([&, client] {
+                try {
+                    QueryClient connection(socket);
+                    Query own = query;
+                    for (unsigned i = 0; i < requests; ++i) {
+                        own.seed = std::uint64_t{client} * requests + i;
+                        const auto sent = Clock::now();
+                        games[client] += connection.run(own).estimate.runs;
+                        latencies[client].push_back(std::chrono::duration<double>(Clock::now() - sent).count());
+                    }
+                }
+                catch (const std::exception & e) {
+                    errors[client] = e.what();
+                }
+            });
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        for (const auto & error : errors) {
+            if (!error.empty()) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+
+        std::vector<double> all;
+        std::uint64_t total_games = 0;
+        for (unsigned client = 0; client < clients; ++client) {
+            all.insert(all.end(), latencies[client].begin(), latencies[client].end());
+            total_games += games[client];
+        }
+        std::sort(all.begin(), all.end());
+        const auto percentile = [&all](const double p) {
+            return all.empty() ? 0 : 1000 * all[std::min(all.size() - 1, static_cast<std::size_t>(p * static_cast<double>(all.size())))];
+        };
+        std::cout << all.size() << " queries in " << seconds << " s: "
+                  << static_cast<double>(all.size()) / seconds << " queries/s, "
+                  << static_cast<double>(total_games) / seconds << " games/s" << std::endl;
+        std::cout << "latency ms: p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+                  << ", p99 " << percentile(0.99) << ", max " << percentile(1) << std::endl;
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // anonymous namespace
+
+// Usage: monte_carlo_st_petersburg [runs [bankroll [threads]]]
+//            [--rng=xoshiro|philox|pcg64|mt19937] [--engine=flip|bits|lanes|binomial|quasi]
+//            [--seed=N] [--threads=N] [--first-trial=N]
+//            [--bet=X] [--multiplier=X] [--tails=P] [--max-rounds=N]
+//            [--checkpoint=FILE [--checkpoint-every=N]] [--output=FILE]
+//            [--trace=FILE|- [--trace-interval=SECONDS]] [--report=csv|json] [--cache=FILE]
+//        monte_carlo_st_petersburg merge [--output=FILE] FILE...
+//        monte_carlo_st_petersburg serve --socket=PATH [--threads=N] [--chunk=N]
+//        monte_carlo_st_petersburg load --socket=PATH [--clients=N] [--requests=N] [--error=X]
+//            [--rng=NAME] [--engine=NAME] [runs [bankroll]]
+// With --checkpoint the games are played in steps of N, the state is saved to
+// FILE after every step and a run found in FILE is resumed instead of started.
+// --output saves the games as a partial result, merge combines partial results
+// of processes with different seeds or disjoint ranges of --first-trial.
+// --trace writes a CSV convergence trace to FILE or standard error.
+// --bet, --multiplier and --tails change the rules of the game, --max-rounds
+// stops every game after N Tails instead of at the bankroll.
+// --report prints the distribution of payouts instead of the mean.
+// --cache keeps the games of seeded runs in FILE for repeated queries.
+// serve answers queries on a Unix domain socket with a warm worker pool,
+// load measures its throughput and latency with concurrent clients
 int main(int argc, char ** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "merge") {
+        return merge_main(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && std::string(argv[1]) == "serve") {
+        return serve_main(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && std::string(argv[1]) == "load") {
+        return load_main(std::vector<std::string>(argv + 2, argv + argc));
+    }
     unsigned long runs = 1000000;
     double bankroll = 1000000;
-    if (argc > 1) {
-        runs = std::stoul(argv[1]);
-        if (argc > 2) {
-            bankroll = std::stod(argv[2]);
+    SimulationOptions options;
+    std::string checkpoint;
+    std::string output;
+    unsigned long checkpoint_every = 100000000;
+    std::string trace;
+    std::string report;
+    std::string cache;
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--checkpoint=", 0) == 0) {
+            checkpoint = arg.substr(arg.find('=') + 1);
+            continue;
+        }
+        if (arg.rfind("--checkpoint-every=", 0) == 0) {
+            checkpoint_every = std::stoul(arg.substr(arg.find('=') + 1));
+            continue;
+        }
+        if (arg.rfind("--trace=", 0) == 0) {
+            trace = arg.substr(arg.find('=') + 1);
+            continue;
+        }
+        if (arg.rfind("--trace-interval=", 0) == 0) {
+            options.observe_interval = std::stod(arg.substr(arg.find('=') + 1));
+            continue;
+        }
+        if (arg.rfind("--report=", 0) == 0) {
+            report = arg.substr(arg.find('=') + 1);
+            if (report != "csv" && report != "json") {
+                std::cerr << "Unknown report format " << report << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (arg.rfind("--output=", 0) == 0) {
+            output = arg.substr(arg.find('=') + 1);
+            continue;
+        }
+        if (arg.rfind("--cache=", 0) == 0) {
+            cache = arg.substr(arg.find('=') + 1);
+            continue;
+        }
+        if (arg.rfind("--", 0) == 0) {
+            if (!parse_option(arg, options)) {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        switch (positional++) {
+        case 0: runs = std::stoul(arg); break;
+        case 1: bankroll = std::stod(arg); break;
+        case 2: options.threads = static_cast<unsigned>(std::stoul(arg)); break;
+        default:
+            std::cerr << "Unexpected argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    std::ofstream trace_file;
+    if (!trace.empty()) {
+        if (trace != "-") {
+            trace_file.open(trace);
+            if (!trace_file) {
+                std::cerr << "Can not open " << trace << std::endl;
+                return 1;
+            }
+        }
+        std::ostream & out = trace == "-" ? std::cerr : trace_file;
+        out << "seconds,trials,mean,std_error,low,high,trials_per_second" << std::endl;
+        options.observer = [&out](const Progress & progress) {
+            out << progress.seconds << ',' << progress.trials << ',' << progress.estimate.mean << ','
+                << progress.estimate.std_error << ',' << progress.estimate.low << ',' << progress.estimate.high << ','
+                << progress.trials_per_second << std::endl;
+            return true;
+        };
+    }
+    try {
+        if (checkpoint.empty() && output.empty() && report.empty()) {
+            const double mean = cache.empty() ? calculate_expected_value(runs, bankroll, options)
+                                              : ResultCache(cache).calculate_expected_value(runs, bankroll, options);
+            std::cout << mean << std::endl;
+            return 0;
+        }
+        // Games of a drawn seed are never asked for again
+        const bool cached = !cache.empty() && options.seed;
+        // Partial result records the seed of its games
+        options.seed = options.seed ? *options.seed : make_random_seed();
+        LevelHistogram levels(bankroll);
+        if (checkpoint.empty()) {
+            levels = cached ? ResultCache(cache).simulate_levels(runs, bankroll, options) : simulate_levels(runs, bankroll, options);
+        }
+        else {
+            const bool resume = std::ifstream(checkpoint).good();
+            Simulation simulation = resume ? Simulation::load(checkpoint) : Simulation(runs, bankroll, options, checkpoint_every);
+            if (resume) {
+                std::cerr << "Resuming after " << simulation.trials_done() << " of " << simulation.runs() << " games" << std::endl;
+                simulation.set_observer(options.observer, options.observe_interval);
+            }
+            levels = simulation.run(checkpoint);
+            options = simulation.options();
         }
+        if (!output.empty()) {
+            write_partial_result(output, make_partial_result(levels, options));
+        }
+        if (report == "csv") {
+            write_report_csv(std::cout, make_distribution_report(levels));
+        }
+        else if (report == "json") {
+            write_report_json(std::cout, make_distribution_report(levels));
+        }
+        else {
+            std::cout << levels.mean() << std::endl;
+        }
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
-    std::cout << calculate_expected_value(runs, bankroll) << std::endl;
 }
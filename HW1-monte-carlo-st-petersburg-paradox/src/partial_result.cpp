@@ -0,0 +1,201 @@
+#include "partial_result.h"
+
+#include "binary_io.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+
+constexpr std::array<char, 4> MAGIC = {'S', 'P', 'P', 'R'};
+// Version 2 added the game rules, version 3 the list of trial ranges
+constexpr std::uint64_t VERSION = 3;
+// Ranges of one file, far more than any merge needs
+constexpr std::uint64_t MAX_RANGES = 1 << 20;
+
+Rng read_rng(std::istream & in)
+{
+    const std::uint64_t rng = read_u64(in);
+    if (rng > static_cast<std::uint64_t>(Rng::Mt19937)) {
+        throw std::runtime_error("Malformed partial result");
+    }
+    return static_cast<Rng>(rng);
+}
+
+Engine read_engine(std::istream & in)
+{
+    const std::uint64_t engine = read_u64(in);
+    if (engine > static_cast<std::uint64_t>(Engine::Quasi)) {
+        throw std::runtime_error("Malformed partial result");
+    }
+    return static_cast<Engine>(engine);
+}
+
+} // anonymous namespace
+
+PartialResult make_partial_result(const LevelHistogram & levels, const SimulationOptions & options)
+{
+    if (!options.seed) {
+        throw std::invalid_argument("Partial result needs the seed of its games");
+    }
+    PartialResult result;
+    result.engine = options.engine;
+    result.ranges.push_back({*options.seed, options.rng, options.first_trial, levels.runs()});
+    result.levels = levels;
+    result.moments = RunningStats(levels);
+    return result;
+}
+
+void write_partial_result(std::ostream & out, const PartialResult & result)
+{
+    out.write(MAGIC.data(), MAGIC.size());
+    write_u64(out, VERSION);
+    write_u64(out, static_cast<std::uint64_t>(result.engine));
+    write_u64(out, result.ranges.size());
+    for (const auto & range : result.ranges) {
+        write_u64(out, range.seed);
+        write_u64(out, static_cast<std::uint64_t>(range.rng));
+        write_u64(out, range.first_trial);
+        write_u64(out, range.trials);
+    }
+    write_u64(out, result.trials());
+    write_double(out, result.levels.bankroll());
+    write_rules(out, result.levels.rules());
+    write_u64(out, result.levels.counts().size());
+    for (const auto count : result.levels.counts()) {
+        write_u64(out, count);
+    }
+    write_double(out, result.moments.mean());
+    write_double(out, result.moments.variance());
+}
+
+void write_partial_result(const std::string & path, const PartialResult & result)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    write_partial_result(out, result);
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("Can not write partial result " + path);
+    }
+}
+
+PartialResult read_partial_result(std::istream & in)
+{
+    std::array<char, 4> magic;
+    if (!in.read(magic.data(), magic.size()) || magic != MAGIC) {
+        throw std::runtime_error("Not a partial result");
+    }
+    const std::uint64_t version = read_u64(in);
+    if (version == 0 || version > VERSION) {
+        throw std::runtime_error("Unsupported partial result version");
+    }
+    PartialResult result;
+    if (version >= 3) {
+        result.engine = read_engine(in);
+        const std::uint64_t ranges = read_u64(in);
+        if (ranges > MAX_RANGES) {
+            throw std::runtime_error("Malformed partial result");
+        }
+        for (std::uint64_t i = 0; i < ranges; ++i) {
+            TrialRange range;
+            range.seed = read_u64(in);
+            range.rng = read_rng(in);
+            range.first_trial = read_u64(in);
+            range.trials = read_u64(in);
+            result.ranges.push_back(range);
+        }
+    }
+    else {
+        // A single range, its length is the number of games
+        TrialRange range;
+        range.seed = read_u64(in);
+        range.rng = read_rng(in);
+        result.engine = read_engine(in);
+        range.first_trial = read_u64(in);
+        result.ranges.push_back(range);
+    }
+    const std::uint64_t trials = read_u64(in);
+    if (version < 3) {
+        result.ranges.front().trials = trials;
+    }
+    const double bankroll = read_double(in);
+    const GameRules rules = version >= 2 ? read_rules(in) : GameRules{};
+    std::uint64_t ranged = 0;
+    for (const auto & range : result.ranges) {
+        ranged += range.trials;
+    }
+    if (!(bankroll > 0) || ranged != trials) {
+        throw std::runtime_error("Malformed partial result");
+    }
+    try {
+        result.levels = LevelHistogram(bankroll, rules);
+    }
+    catch (const std::invalid_argument & e) {
+        throw std::runtime_error(std::string("Malformed partial result: ") + e.what());
+    }
+    if (read_u64(in) != result.levels.counts().size()) {
+        throw std::runtime_error("Malformed partial result");
+    }
+    for (unsigned level = 0; level <= result.levels.level_cap(); ++level) {
+        result.levels.add(level, read_u64(in));
+    }
+    const double mean = read_double(in);
+    const double variance = read_double(in);
+    if (result.trials() != trials) {
+        throw std::runtime_error("Malformed partial result");
+    }
+    result.moments = RunningStats::from_moments(trials, mean, variance);
+    return result;
+}
+
+PartialResult read_partial_result(const std::string & path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Can not open partial result " + path);
+    }
+    return read_partial_result(in);
+}
+
+PartialResult merge_partial_results(const std::vector<PartialResult> & results)
+{
+    if (results.empty()) {
+        return PartialResult{};
+    }
+    std::vector<TrialRange> ranges;
+    for (const auto & result : results) {
+        for (const auto & range : result.ranges) {
+            if (range.trials != 0) {
+                ranges.push_back(range);
+            }
+        }
+    }
+    // Ranges of one stream side by side, in the order of their games
+    std::sort(ranges.begin(), ranges.end(), [](const TrialRange & a, const TrialRange & b) {
+        return std::make_tuple(a.seed, a.rng, a.first_trial) < std::make_tuple(b.seed, b.rng, b.first_trial);
+    });
+
+    PartialResult result = results.front();
+    result.ranges.clear();
+    for (const auto & range : ranges) {
+        if (!result.ranges.empty() && result.ranges.back().same_stream(range)) {
+            TrialRange & last = result.ranges.back();
+            if (range.first_trial < last.first_trial + last.trials) {
+                throw std::invalid_argument("Partial results share games");
+            }
+            if (range.first_trial == last.first_trial + last.trials) {
+                last.trials += range.trials;
+                continue;
+            }
+        }
+        result.ranges.push_back(range);
+    }
+    for (std::size_t i = 1; i < results.size(); ++i) {
+        result.levels.merge(results[i].levels);
+        result.moments.merge(results[i].moments);
+    }
+    return result;
+}
@@ -0,0 +1,489 @@
+#include "query_server.h"
+
+#include "binary_io.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Longer frames are not ours, the connection is dropped
+constexpr std::uint64_t MAX_FRAME = 1 << 20;
+
+bool read_exact(const int fd, char * data, std::size_t size)
+{
+    while (size > 0) {
+        const ssize_t done = read(fd, data, size);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        }
+        if (done <= 0) {
+            return false;
+        }
+        data += done;
+        size -= static_cast<std::size_t>(done);
+    }
+    return true;
+}
+
+bool write_all(const int fd, const char * data, std::size_t size)
+{
+    while (size > 0) {
+        // A closed peer must not kill the process with SIGPIPE
+        const ssize_t done = send(fd, data, size, MSG_NOSIGNAL);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        }
+        if (done <= 0) {
+            return false;
+        }
+        data += done;
+        size -= static_cast<std::size_t>(done);
+    }
+    return true;
+}
+
+// False once the peer is gone or sends garbage
+bool read_frame(const int fd, std::string & payload)
+{
+    char length[8];
+    if (!read_exact(fd, length, sizeof length)) {
+        return false;
+    }
+    std::istringstream in(std::string(length, sizeof length));
+    const std::uint64_t size = read_u64(in);
+    if (size > MAX_FRAME) {
+        return false;
+    }
+    payload.resize(size);
+    return read_exact(fd, payload.data(), payload.size());
+}
+
+bool write_frame(const int fd, const std::string & payload)
+{
+    std::ostringstream out;
+    write_u64(out, payload.size());
+    out << payload;
+    const std::string frame = out.str();
+    return write_all(fd, frame.data(), frame.size());
+}
+
+void write_string(std::ostream & out, const std::string & value)
+{
+    write_u64(out, value.size());
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+std::string read_string(std::istream & in)
+{
+    const std::uint64_t size = read_u64(in);
+    if (size > MAX_FRAME) {
+        throw std::runtime_error("Malformed reply");
+    }
+    std::string value(size, '\0');
+    if (!in.read(value.data(), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Truncated file");
+    }
+    return value;
+}
+
+// Half-width of the interval reached the target of the query
+bool precise_enough(const Query & query, const Estimate & estimate)
+{
+    const double half_width = estimate.high - estimate.mean;
+    return (query.absolute_error > 0 && half_width <= query.absolute_error) ||
+           (query.relative_error > 0 && half_width <= query.relative_error * std::abs(estimate.mean));
+}
+
+} // anonymous namespace
+
+void write_query(std::ostream & out, const Query & query)
+{
+    write_u64(out, query.runs);
+    write_double(out, query.bankroll);
+    write_double(out, query.absolute_error);
+    write_double(out, query.relative_error);
+    write_u64(out, static_cast<std::uint64_t>(query.engine));
+    write_u64(out, static_cast<std::uint64_t>(query.rng));
+    write_u64(out, query.seed ? 1 : 0);
+    write_u64(out, query.seed.value_or(0));
+}
+
+Query read_query(std::istream & in)
+{
+    Query query;
+    query.runs = read_u64(in);
+    query.bankroll = read_double(in);
+    query.absolute_error = read_double(in);
+    query.relative_error = read_double(in);
+    const std::uint64_t engine = read_u64(in);
+    const std::uint64_t rng = read_u64(in);
+    const std::uint64_t has_seed = read_u64(in);
+    const std::uint64_t seed = read_u64(in);
+    if (engine > static_cast<std::uint64_t>(Engine::Quasi) || rng > static_cast<std::uint64_t>(Rng::Mt19937) || has_seed > 1) {
+        throw std::runtime_error("Malformed query");
+    }
+    query.engine = static_cast<Engine>(engine);
+    query.rng = static_cast<Rng>(rng);
+    if (has_seed) {
+        query.seed = seed;
+    }
+    return query;
+}
+
+void write_reply(std::ostream & out, const Reply & reply)
+{
+    write_u64(out, static_cast<std::uint64_t>(reply.kind));
+    write_u64(out, reply.seed);
+    write_u64(out, reply.estimate.runs);
+    write_double(out, reply.estimate.mean);
+    write_double(out, reply.estimate.std_error);
+    write_double(out, reply.estimate.low);
+    write_double(out, reply.estimate.high);
+    write_string(out, reply.error);
+}
+
+Reply read_reply(std::istream & in)
+{
+    Reply reply;
+    const std::uint64_t kind = read_u64(in);
+    if (kind > static_cast<std::uint64_t>(ReplyKind::Error)) {
+        throw std::runtime_error("Malformed reply");
+    }
+    reply.kind = static_cast<ReplyKind>(kind);
+    reply.seed = read_u64(in);
+    reply.estimate.runs = read_u64(in);
+    reply.estimate.mean = read_double(in);
+    reply.estimate.std_error = read_double(in);
+    reply.estimate.low = read_double(in);
+    reply.estimate.high = read_double(in);
+    reply.error = read_string(in);
+    return reply;
+}
+
+// Socket of one client, shared by its reader and the workers playing its query
+struct QueryServer::Connection
+{
+    explicit Connection(const int fd)
+        : fd(fd)
+    {
+    }
+
+    ~Connection() { close(fd); }
+
+    // Replies of a query come from several workers: progress older than
+    // what the client has already seen, or of an earlier query, is dropped.
+    // False once the client is gone
+    bool send(const std::uint64_t job, const Reply & reply)
+    {
+        const std::lock_guard lock(mutex);
+        if (lost || job < last_job || (job == last_job && reply.kind == ReplyKind::Progress && reply.estimate.runs <= last_runs)) {
+            return !lost;
+        }
+        last_job = job;
+        last_runs = reply.estimate.runs;
+        std::ostringstream payload;
+        write_reply(payload, reply);
+        lost = !write_frame(fd, payload.str());
+        return !lost;
+    }
+
+    const int fd;
+    std::mutex mutex;
+    std::uint64_t last_job = 0;
+    std::uint64_t last_runs = 0;
+    bool lost = false;
+};
+
+// Query being played, guarded by the server mutex
+struct QueryServer::Job
+{
+    std::uint64_t id;
+    Query query;
+    SimulationOptions options;
+    std::shared_ptr<Connection> connection;
+    LevelHistogram levels;
+    // Games handed out to the workers
+    std::uint64_t claimed = 0;
+    // Chunks being played
+    unsigned in_flight = 0;
+    // No more chunks are handed out
+    bool finished = false;
+
+    bool done() const { return finished && in_flight == 0; }
+};
+
+QueryServer::QueryServer(const std::string & path, const unsigned threads, const unsigned long chunk)
+    : m_path(path)
+    , m_chunk(std::max(chunk, 1UL))
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof address.sun_path) {
+        throw std::runtime_error("Socket path is too long " + path);
+    }
+    std::copy(path.begin(), path.end(), address.sun_path);
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+        throw std::runtime_error("Can not create socket " + path);
+    }
+    unlink(path.c_str());
+    if (bind(m_listen_fd, reinterpret_cast<const sockaddr *>(&address), sizeof address) != 0 || listen(m_listen_fd, SOMAXCONN) != 0 ||
+        pipe(m_wake_fds) != 0) {
+        close(m_listen_fd);
+        throw std::runtime_error("Can not listen on " + path);
+    }
+    // Warm pool: no thread is started per query
+    const unsigned workers = resolve_threads(std::numeric_limits<unsigned long>::max(), threads);
+    for (unsigned i = 0; i < workers; ++i) {
+        m_workers.emplace_back(&QueryServer::work, this);
+    }
+}
+
+QueryServer::~QueryServer()
+{
+    stop();
+    {
+        std::unique_lock lock(m_mutex);
+        m_changed.wait(lock, [this] { return m_readers == 0; });
+    }
+    for (auto & worker : m_workers) {
+        worker.join();
+    }
+    close(m_listen_fd);
+    close(m_wake_fds[0]);
+    close(m_wake_fds[1]);
+    unlink(m_path.c_str());
+}
+
+void QueryServer::run()
+{
+    for (;;) {
+        pollfd fds[2] = {{m_listen_fd, POLLIN, 0}, {m_wake_fds[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        if ((fds[0].revents & POLLIN) == 0) {
+            continue;
+        }
+        const int fd = accept(m_listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        const auto connection = std::make_shared<Connection>(fd);
+        const std::lock_guard lock(m_mutex);
+        if (m_stopping) {
+            break;
+        }
+        m_connections.push_back(connection);
+        ++m_readers;
+        std::thread(&QueryServer::serve, this, connection).detach();
+    }
+}
+
+void QueryServer::stop()
+{
+    {
+        const std::lock_guard lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_stopping = true;
+        // Wakes the readers blocked on their sockets
+        for (const auto & connection : m_connections) {
+            shutdown(connection->fd, SHUT_RDWR);
+        }
+        m_queue.clear();
+    }
+    m_changed.notify_all();
+    const char wake = 0;
+    while (write(m_wake_fds[1], &wake, 1) < 0 && errno == EINTR) {
+    }
+}
+
+std::size_t QueryServer::connections()
+{
+    const std::lock_guard lock(m_mutex);
+    return m_connections.size();
+}
+
+void QueryServer::serve(const std::shared_ptr<Connection> connection)
+{
+    play(connection);
+    const std::lock_guard lock(m_mutex);
+    m_connections.erase(std::remove(m_connections.begin(), m_connections.end(), connection), m_connections.end());
+    --m_readers;
+    // Under the lock: the server may be destroyed as soon as it is released
+    m_changed.notify_all();
+}
+
+void QueryServer::play(const std::shared_ptr<Connection> & connection)
+{
+    std::uint64_t jobs = 0;
+    std::string payload;
+    while (read_frame(connection->fd, payload)) {
+        const std::uint64_t id = ++jobs;
+        Reply reply;
+        std::shared_ptr<Job> job;
+        try {
+            std::istringstream in(payload);
+            const Query query = read_query(in);
+            if (!(query.bankroll > 0)) {
+                throw std::invalid_argument("Bankroll must be positive");
+            }
+            if (query.engine == Engine::Quasi) {
+                throw std::invalid_argument("Quasi-Monte Carlo queries are not served");
+            }
+            SimulationOptions options;
+            options.threads = 1;
+            options.seed = query.seed ? *query.seed : make_random_seed();
+            options.engine = query.engine;
+            options.rng = query.rng;
+            job = std::make_shared<Job>(Job{id, query, options, connection, LevelHistogram(query.bankroll)});
+            reply.seed = *options.seed;
+        }
+        catch (const std::exception & e) {
+            reply.kind = ReplyKind::Error;
+            reply.error = e.what();
+            connection->send(id, reply);
+            continue;
+        }
+        if (job->query.runs == 0) {
+            reply.kind = ReplyKind::Done;
+            connection->send(id, reply);
+            continue;
+        }
+
+        std::unique_lock lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_queue.push_back(job);
+        m_changed.notify_all();
+        // Client sends the next query after the final reply
+        m_changed.wait(lock, [&] { return m_stopping || job->done(); });
+        if (m_stopping) {
+            return;
+        }
+    }
+}
+
+void QueryServer::work()
+{
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        m_changed.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_stopping) {
+            return;
+        }
+        // Next chunk of the query at the front, which then goes to the back of the line
+        const auto job = m_queue.front();
+        m_queue.pop_front();
+        const std::uint64_t first = job->claimed;
+        const unsigned long count = static_cast<unsigned long>(std::min<std::uint64_t>(m_chunk, job->query.runs - first));
+        job->claimed += count;
+        ++job->in_flight;
+        if (job->claimed < job->query.runs) {
+            m_queue.push_back(job);
+            m_changed.notify_all();
+        }
+        lock.unlock();
+
+        SimulationOptions options = job->options;
+        options.first_trial = first;
+        const LevelHistogram played = simulate_levels(count, job->query.bankroll, options);
+
+        lock.lock();
+        job->levels.merge(played);
+        --job->in_flight;
+        Reply reply;
+        reply.seed = *job->options.seed;
+        reply.estimate = RunningStats(job->levels).estimate(0.95);
+        if (!job->finished && (job->claimed == job->query.runs || precise_enough(job->query, reply.estimate))) {
+            job->finished = true;
+            m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), job), m_queue.end());
+        }
+        if (job->done()) {
+            reply.kind = ReplyKind::Done;
+            m_changed.notify_all();
+        }
+        lock.unlock();
+        const bool delivered = job->connection->send(job->id, reply);
+        lock.lock();
+        if (!delivered && !job->finished) {
+            // Nobody waits for the rest of the games
+            job->finished = true;
+            m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), job), m_queue.end());
+            if (job->done()) {
+                m_changed.notify_all();
+            }
+        }
+    }
+}
+
+QueryClient::QueryClient(const std::string & path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof address.sun_path) {
+        throw std::runtime_error("Socket path is too long " + path);
+    }
+    std::copy(path.begin(), path.end(), address.sun_path);
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd < 0 || connect(m_fd, reinterpret_cast<const sockaddr *>(&address), sizeof address) != 0) {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+        throw std::runtime_error("Can not connect to " + path);
+    }
+}
+
+QueryClient::~QueryClient()
+{
+    close(m_fd);
+}
+
+Reply QueryClient::run(const Query & query, const std::function<void(const Reply &)> & on_progress)
+{
+    std::ostringstream out;
+    write_query(out, query);
+    if (!write_frame(m_fd, out.str())) {
+        throw std::runtime_error("Connection to the server is lost");
+    }
+    std::string payload;
+    for (;;) {
+        if (!read_frame(m_fd, payload)) {
+            throw std::runtime_error("Connection to the server is lost");
+        }
+        std::istringstream in(payload);
+        Reply reply = read_reply(in);
+        switch (reply.kind) {
+        case ReplyKind::Error:
+            throw std::runtime_error(reply.error);
+        case ReplyKind::Done:
+            return reply;
+        case ReplyKind::Progress:
+            if (on_progress) {
+                on_progress(reply);
+            }
+            break;
+        }
+    }
+}
@@ -1,10 +1,167 @@
 #include "random_gen.h"
 
-#include <random>
+namespace {
+
+std::uint64_t splitmix64(std::uint64_t & state)
+{
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+Xoshiro256 & thread_engine()
+{
+    thread_local Xoshiro256 rnd(make_random_seed());
+    return rnd;
+}
+
+template <class Generator>
+void fill_words(Generator & rnd, std::uint64_t * out, const std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = rnd();
+    }
+}
+
+template <class Generator>
+void fill_doubles(Generator & rnd, double * out, const std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = to_unit_double(rnd());
+    }
+}
+
+} // anonymous namespace
 
 double get_random_number()
 {
-    static std::mt19937 rnd(std::random_device{}());
-    static std::uniform_real_distribution dist;
-    return dist(rnd);
+    // No static-init guard and call into the engine on every number
+    thread_local std::array<double, 256> block;
+    thread_local std::size_t pos = block.size();
+    if (pos == block.size()) {
+        fill_random_numbers(block.data(), block.size());
+        pos = 0;
+    }
+    return block[pos++];
+}
+
+void fill_random_numbers(double * out, const std::size_t n)
+{
+    thread_engine().fill(out, n);
+}
+
+void fill_random_bits(std::uint64_t * out, const std::size_t n)
+{
+    thread_engine().fill(out, n);
+}
+
+std::uint64_t make_random_seed()
+{
+    std::random_device device;
+    return (static_cast<std::uint64_t>(device()) << 32) | device();
+}
+
+std::uint64_t mix_seed(const std::uint64_t seed, std::uint64_t value)
+{
+    std::uint64_t state = seed ^ splitmix64(value);
+    return splitmix64(state);
+}
+
+Xoshiro256::Xoshiro256(std::uint64_t seed)
+{
+    // SplitMix64 expands the seed, it never yields an all-zero state
+    for (auto & word : m_state) {
+        word = splitmix64(seed);
+    }
+}
+
+Xoshiro256 Xoshiro256::stream(const std::uint64_t seed, const std::uint64_t stream_id)
+{
+    Xoshiro256 result(seed);
+    for (std::uint64_t i = 0; i < stream_id; ++i) {
+        result.jump();
+    }
+    return result;
+}
+
+void Xoshiro256::fill(std::uint64_t * out, const std::size_t n)
+{
+    fill_words(*this, out, n);
+}
+
+void Xoshiro256::fill(double * out, const std::size_t n)
+{
+    fill_doubles(*this, out, n);
+}
+
+void Xoshiro256::jump()
+{
+    static const std::uint64_t JUMP[] = {0x180EC6D33CFD0ABA, 0xD5A61266F0C9392C, 0xA9582618E03FC9AA, 0x39ABDC4529B1661C};
+    std::array<std::uint64_t, 4> s = {0, 0, 0, 0};
+    for (const std::uint64_t jump : JUMP) {
+        for (int b = 0; b < 64; ++b) {
+            if (jump & (std::uint64_t{1} << b)) {
+                for (int i = 0; i < 4; ++i) {
+                    s[i] ^= m_state[i];
+                }
+            }
+            (*this)();
+        }
+    }
+    m_state = s;
+}
+
+Pcg64::Pcg64(const std::uint64_t seed, const std::uint64_t stream_id)
+    : m_state(0)
+    , m_increment((static_cast<uint128>(stream_id) << 1) | 1)
+{
+    // Reference pcg64 seeding: step, add the seed, step
+    (*this)();
+    m_state += seed;
+    (*this)();
+}
+
+void Pcg64::fill(std::uint64_t * out, const std::size_t n)
+{
+    fill_words(*this, out, n);
+}
+
+void Pcg64::fill(double * out, const std::size_t n)
+{
+    fill_doubles(*this, out, n);
+}
+
+Mt19937::Mt19937(const std::uint64_t seed, const std::uint64_t stream_id)
+{
+    std::seed_seq sequence{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32), static_cast<std::uint32_t>(stream_id), static_cast<std::uint32_t>(stream_id >> 32)};
+    m_engine.seed(sequence);
+}
+
+void Mt19937::fill(std::uint64_t * out, const std::size_t n)
+{
+    fill_words(*this, out, n);
+}
+
+void Mt19937::fill(double * out, const std::size_t n)
+{
+    fill_doubles(*this, out, n);
+}
+
+Philox4x32::Philox4x32(const std::uint64_t key, const std::uint64_t trial)
+    : m_counter{0, 0, static_cast<std::uint32_t>(trial), static_cast<std::uint32_t>(trial >> 32)}
+    , m_key{static_cast<std::uint32_t>(key), static_cast<std::uint32_t>(key >> 32)}
+    , m_buffer{}
+    , m_used(4)
+{
+}
+
+void Philox4x32::fill(std::uint64_t * out, const std::size_t n)
+{
+    fill_words(*this, out, n);
+}
+
+void Philox4x32::fill(double * out, const std::size_t n)
+{
+    fill_doubles(*this, out, n);
 }
@@ -0,0 +1,316 @@
+#include "result_cache.h"
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::array<char, 4> MAGIC = {'S', 'P', 'R', 'C'};
+constexpr std::uint64_t VERSION = 1;
+// Slots an entry may take: from hash % slots on, the next ones in turn
+constexpr std::size_t PROBE = 16;
+
+// Start of the file, slots follow it
+struct Header
+{
+    std::array<char, 4> magic;
+    std::uint32_t reserved;
+    std::uint64_t version;
+    std::uint64_t slots;
+    // Ticks on every use of an entry, orders the entries for eviction
+    std::uint64_t clock;
+};
+
+std::uint64_t bits_of(const double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+// Games of every trial come from a stream of their own:
+// the first n games of a longer run are the games of a run of n
+bool extendable(const SimulationOptions & options)
+{
+    return options.rng == Rng::Philox && (options.engine == Engine::Flip || options.engine == Engine::Bits);
+}
+
+} // anonymous namespace
+
+// Everything but the number of games that decides the result of a query
+struct ResultCache::Key
+{
+    std::array<std::uint64_t, 12> words;
+
+    Key(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+    {
+        // Streams of a worker or a replicate depend on their number unless every game or the whole run has its own
+        std::uint64_t streams = 0;
+        if (options.engine == Engine::Quasi) {
+            streams = options.replicates;
+        }
+        else if (!extendable(options) && options.engine != Engine::Binomial) {
+            streams = resolve_threads(runs, options.threads);
+        }
+        words = {ENGINE_VERSION,
+                 *options.seed,
+                 static_cast<std::uint64_t>(options.rng),
+                 static_cast<std::uint64_t>(options.engine),
+                 options.first_trial,
+                 streams,
+                 bits_of(bankroll),
+                 bits_of(options.rules.initial_bet),
+                 bits_of(options.rules.multiplier),
+                 bits_of(options.rules.tails_probability),
+                 static_cast<std::uint64_t>(options.rules.cap),
+                 options.rules.max_rounds};
+    }
+
+    // FNV-1a of the words, 0 marks an empty slot
+    std::uint64_t hash() const
+    {
+        std::uint64_t hash = 0xcbf29ce484222325;
+        for (const auto word : words) {
+            for (unsigned i = 0; i < 8; ++i) {
+                hash = (hash ^ ((word >> (8 * i)) & 0xFF)) * 0x100000001b3;
+            }
+        }
+        return hash == 0 ? 1 : hash;
+    }
+};
+
+struct ResultCache::Slot
+{
+    std::uint64_t hash;
+    std::uint64_t last_used;
+    std::array<std::uint64_t, 12> key;
+    std::uint64_t runs;
+    std::uint64_t levels;
+    std::array<std::uint64_t, MAX_LEVELS> counts;
+
+    bool matches(const std::uint64_t key_hash, const Key & query) const
+    {
+        return hash == key_hash && key == query.words;
+    }
+};
+
+// Exclusive lock of the whole file, other threads of the object and other processes wait for it
+class ResultCache::Lock
+{
+public:
+    explicit Lock(const ResultCache & cache)
+        : m_guard(cache.m_mutex)
+        , m_fd(cache.m_fd)
+    {
+        // flock() of one descriptor does not keep out the threads sharing it
+        while (flock(m_fd, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                throw std::runtime_error("Can not lock result cache");
+            }
+        }
+    }
+
+    ~Lock() { flock(m_fd, LOCK_UN); }
+
+    Lock(const Lock &) = delete;
+    Lock & operator=(const Lock &) = delete;
+
+private:
+    std::lock_guard<std::mutex> m_guard;
+    int m_fd;
+};
+
+ResultCache::ResultCache(const std::string & path, const std::size_t max_bytes)
+{
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) {
+        throw std::runtime_error("Can not open result cache " + path);
+    }
+    try {
+        const Lock lock(*this);
+        struct stat status;
+        if (fstat(m_fd, &status) != 0) {
+            throw std::runtime_error("Can not open result cache " + path);
+        }
+        std::size_t slots = 0;
+        if (status.st_size == 0) {
+            slots = std::max<std::size_t>(max_bytes > sizeof(Header) ? (max_bytes - sizeof(Header)) / sizeof(Slot) : 0, 1);
+            m_bytes = sizeof(Header) + slots * sizeof(Slot);
+            // New file reads as zeros: every slot is empty
+            if (ftruncate(m_fd, static_cast<off_t>(m_bytes)) != 0) {
+                throw std::runtime_error("Can not resize result cache " + path);
+            }
+        }
+        else {
+            m_bytes = static_cast<std::size_t>(status.st_size);
+        }
+        if (m_bytes < sizeof(Header)) {
+            throw std::runtime_error("Not a result cache");
+        }
+        m_data = mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (m_data == MAP_FAILED) {
+            m_data = nullptr;
+            throw std::runtime_error("Can not map result cache " + path);
+        }
+        auto & header = *static_cast<Header *>(m_data);
+        if (status.st_size == 0) {
+            header.magic = MAGIC;
+            header.version = VERSION;
+            header.slots = slots;
+        }
+        if (header.magic != MAGIC || header.version != VERSION) {
+            throw std::runtime_error("Not a result cache");
+        }
+        if (header.slots == 0 || m_bytes != sizeof(Header) + header.slots * sizeof(Slot)) {
+            throw std::runtime_error("Malformed result cache");
+        }
+        m_slots = header.slots;
+    }
+    catch (...) {
+        if (m_data != nullptr) {
+            munmap(m_data, m_bytes);
+        }
+        close(m_fd);
+        throw;
+    }
+}
+
+ResultCache::~ResultCache()
+{
+    munmap(m_data, m_bytes);
+    close(m_fd);
+}
+
+ResultCache::Slot & ResultCache::slot(const std::size_t index) const
+{
+    return reinterpret_cast<Slot *>(static_cast<char *>(m_data) + sizeof(Header))[index];
+}
+
+std::size_t ResultCache::probe() const
+{
+    return std::min(PROBE, m_slots);
+}
+
+std::size_t ResultCache::size() const
+{
+    const Lock lock(*this);
+    std::size_t result = 0;
+    for (std::size_t i = 0; i < m_slots; ++i) {
+        result += slot(i).hash != 0 ? 1 : 0;
+    }
+    return result;
+}
+
+void ResultCache::clear()
+{
+    const Lock lock(*this);
+    for (std::size_t i = 0; i < m_slots; ++i) {
+        slot(i).hash = 0;
+    }
+}
+
+LevelHistogram ResultCache::simulate_levels(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+{
+    LevelHistogram result(bankroll, options.rules);
+    if (!options.seed || result.counts().size() > MAX_LEVELS) {
+        ++m_misses;
+        return ::simulate_levels(runs, bankroll, options);
+    }
+    const Key key(runs, bankroll, options);
+    const std::uint64_t hash = key.hash();
+    auto & header = *static_cast<Header *>(m_data);
+
+    // Cached games: the whole run, or else the longest run it extends
+    std::uint64_t cached = 0;
+    bool hit = false;
+    {
+        const Lock lock(*this);
+        Slot * found = nullptr;
+        for (std::size_t i = 0; i < probe(); ++i) {
+            Slot & entry = slot((hash + i) % m_slots);
+            if (!entry.matches(hash, key) || entry.levels != result.counts().size()) {
+                continue;
+            }
+            if (entry.runs == runs) {
+                found = &entry;
+                break;
+            }
+            if (extendable(options) && entry.runs < runs && (found == nullptr || entry.runs > found->runs)) {
+                found = &entry;
+            }
+        }
+        if (found != nullptr) {
+            found->last_used = ++header.clock;
+            cached = found->runs;
+            hit = cached == runs;
+            for (unsigned level = 0; level < found->levels; ++level) {
+                result.add(level, found->counts[level]);
+            }
+        }
+    }
+    if (hit) {
+        ++m_hits;
+        return result;
+    }
+
+    // Missing games are played without holding the lock
+    SimulationOptions rest = options;
+    rest.first_trial = options.first_trial + cached;
+    const LevelHistogram played = ::simulate_levels(runs - cached, bankroll, rest);
+    ++(cached > 0 ? m_extensions : m_misses);
+    result.merge(played);
+    if (played.runs() < runs - cached) {
+        // Cancelled by the observer, a part of the run is not worth keeping
+        return result;
+    }
+
+    const Lock lock(*this);
+    Slot * target = &slot(hash % m_slots);
+    for (std::size_t i = 0; i < probe(); ++i) {
+        Slot & entry = slot((hash + i) % m_slots);
+        // Another process may have stored the same run meanwhile
+        if (entry.matches(hash, key) && entry.runs == runs) {
+            target = &entry;
+            break;
+        }
+        // Empty slot or else the least recently used one
+        if (target->hash != 0 && (entry.hash == 0 || entry.last_used < target->last_used)) {
+            target = &entry;
+        }
+    }
+    target->hash = 0;
+    target->key = key.words;
+    target->runs = runs;
+    target->levels = result.counts().size();
+    std::copy(result.counts().begin(), result.counts().end(), target->counts.begin());
+    target->last_used = ++header.clock;
+    target->hash = hash;
+    return result;
+}
+
+double ResultCache::calculate_expected_value(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+{
+    if (options.estimator != Estimator::Plain) {
+        return ::calculate_expected_value(runs, bankroll, options);
+    }
+    return simulate_levels(runs, bankroll, options).mean();
+}
+
+Estimate ResultCache::estimate_expected_value(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+{
+    if (options.estimator != Estimator::Plain || options.engine == Engine::Quasi) {
+        return ::estimate_expected_value(runs, bankroll, options);
+    }
+    return RunningStats(simulate_levels(runs, bankroll, options)).estimate(0.95);
+}
@@ -0,0 +1,112 @@
+#include "running_stats.h"
+
+#include <cmath>
+#include <limits>
+
+Estimate make_estimate(const double mean, const double std_error, const unsigned long runs, const double confidence)
+{
+    const double half_width = normal_quantile(0.5 + confidence / 2) * std_error;
+    Estimate result;
+    result.mean = mean;
+    result.std_error = std_error;
+    result.low = mean - half_width;
+    result.high = mean + half_width;
+    result.runs = runs;
+    return result;
+}
+
+RunningStats::RunningStats(const LevelHistogram & levels)
+{
+    for (unsigned level = 0; level <= levels.level_cap(); ++level) {
+        add(levels.payout(level), levels.counts()[level]);
+    }
+}
+
+RunningStats RunningStats::from_moments(const std::uint64_t count, const double mean, const double variance)
+{
+    RunningStats result;
+    result.m_count = count;
+    result.m_mean = count == 0 ? 0 : mean;
+    result.m_m2 = count < 2 ? 0 : variance * (count - 1);
+    return result;
+}
+
+void RunningStats::add(const double value)
+{
+    ++m_count;
+    const double delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (value - m_mean);
+}
+
+void RunningStats::add(const double value, const std::uint64_t count)
+{
+    RunningStats block;
+    block.m_count = count;
+    block.m_mean = value;
+    merge(block);
+}
+
+void RunningStats::merge(const RunningStats & other)
+{
+    if (other.m_count == 0) {
+        return;
+    }
+    if (m_count == 0) {
+        *this = other;
+        return;
+    }
+    // Chan et al. pairwise update
+    const double n = static_cast<double>(m_count) + other.m_count;
+    const double delta = other.m_mean - m_mean;
+    m_mean += delta * (other.m_count / n);
+    m_m2 += other.m_m2 + delta * delta * (m_count / n) * other.m_count;
+    m_count += other.m_count;
+}
+
+double RunningStats::variance() const
+{
+    return m_count < 2 ? 0 : m_m2 / (m_count - 1);
+}
+
+double RunningStats::std_error() const
+{
+    return m_count == 0 ? 0 : std::sqrt(variance() / m_count);
+}
+
+Estimate RunningStats::estimate(const double confidence) const
+{
+    return make_estimate(m_mean, std_error(), static_cast<unsigned long>(m_count), confidence);
+}
+
+double normal_quantile(const double p)
+{
+    if (p <= 0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    if (p >= 1) {
+        return std::numeric_limits<double>::infinity();
+    }
+    // Acklam's rational approximation, relative error below 1.2e-9
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00};
+    const double p_low = 0.02425;
+
+    double x;
+    if (p < p_low) {
+        const double q = std::sqrt(-2 * std::log(p));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+    else if (p <= 1 - p_low) {
+        const double q = p - 0.5;
+        const double r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+    }
+    else {
+        const double q = std::sqrt(-2 * std::log(1 - p));
+        x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    }
+    return x;
+}
@@ -0,0 +1,162 @@
+#include "simulation.h"
+
+#include "binary_io.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr std::array<char, 4> MAGIC = {'S', 'P', 'C', 'K'};
+// Version 2 added the game rules
+constexpr std::uint64_t VERSION = 2;
+
+} // anonymous namespace
+
+Simulation::Simulation(const unsigned long runs, const double bankroll, const SimulationOptions & options, const unsigned long interval)
+    : m_runs(runs)
+    , m_interval(interval)
+    , m_options(options)
+    , m_levels(bankroll, options.rules)
+{
+    if (interval == 0) {
+        throw std::invalid_argument("Checkpoint interval must be positive");
+    }
+    if (options.estimator != Estimator::Plain) {
+        throw std::invalid_argument("Only the plain estimator can be checkpointed");
+    }
+    m_options.seed = options.seed ? *options.seed : make_random_seed();
+    m_options.threads = resolve_threads(interval, options.threads);
+}
+
+Simulation Simulation::load(std::istream & in)
+{
+    std::array<char, 4> magic;
+    if (!in.read(magic.data(), magic.size()) || magic != MAGIC) {
+        throw std::runtime_error("Not a checkpoint");
+    }
+    const std::uint64_t version = read_u64(in);
+    if (version == 0 || version > VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version");
+    }
+    const std::uint64_t runs = read_u64(in);
+    const double bankroll = read_double(in);
+    const std::uint64_t interval = read_u64(in);
+    SimulationOptions options;
+    options.seed = read_u64(in);
+    options.threads = static_cast<unsigned>(read_u64(in));
+    const std::uint64_t rng = read_u64(in);
+    const std::uint64_t engine = read_u64(in);
+    options.first_trial = read_u64(in);
+    if (version >= 2) {
+        options.rules = read_rules(in);
+    }
+    if (interval == 0 || options.threads == 0 || !(bankroll > 0) || rng > static_cast<std::uint64_t>(Rng::Mt19937) ||
+        engine > static_cast<std::uint64_t>(Engine::Quasi)) {
+        throw std::runtime_error("Malformed checkpoint");
+    }
+    options.rng = static_cast<Rng>(rng);
+    options.engine = static_cast<Engine>(engine);
+    try {
+        options.rules.validate();
+    }
+    catch (const std::invalid_argument & e) {
+        throw std::runtime_error(std::string("Malformed checkpoint: ") + e.what());
+    }
+
+    Simulation result(runs, bankroll, options, interval);
+    result.m_trials_done = read_u64(in);
+    const std::uint64_t levels = read_u64(in);
+    if (levels != result.m_levels.counts().size() || result.m_trials_done > runs) {
+        throw std::runtime_error("Malformed checkpoint");
+    }
+    for (unsigned level = 0; level < levels; ++level) {
+        result.m_levels.add(level, read_u64(in));
+    }
+    if (result.m_levels.runs() != result.m_trials_done) {
+        throw std::runtime_error("Malformed checkpoint");
+    }
+    return result;
+}
+
+Simulation Simulation::load(const std::string & path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Can not open checkpoint " + path);
+    }
+    return load(in);
+}
+
+void Simulation::save(std::ostream & out) const
+{
+    out.write(MAGIC.data(), MAGIC.size());
+    write_u64(out, VERSION);
+    write_u64(out, m_runs);
+    write_double(out, m_levels.bankroll());
+    write_u64(out, m_interval);
+    write_u64(out, *m_options.seed);
+    write_u64(out, m_options.threads);
+    write_u64(out, static_cast<std::uint64_t>(m_options.rng));
+    write_u64(out, static_cast<std::uint64_t>(m_options.engine));
+    write_u64(out, m_options.first_trial);
+    write_rules(out, m_options.rules);
+    write_u64(out, m_trials_done);
+    write_u64(out, m_levels.counts().size());
+    for (const auto count : m_levels.counts()) {
+        write_u64(out, count);
+    }
+}
+
+void Simulation::save(const std::string & path) const
+{
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        save(out);
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Can not write checkpoint " + temporary);
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Can not replace checkpoint " + path);
+    }
+}
+
+void Simulation::set_observer(std::function<bool(const Progress &)> observer, const double interval)
+{
+    m_options.observer = std::move(observer);
+    m_options.observe_interval = interval;
+}
+
+bool Simulation::step()
+{
+    if (done()) {
+        return false;
+    }
+    const unsigned long count = std::min(m_interval, m_runs - m_trials_done);
+    SimulationOptions options = m_options;
+    options.first_trial = m_options.first_trial + m_trials_done;
+    const LevelHistogram played = simulate_levels(count, m_levels.bankroll(), options);
+    if (played.runs() < count) {
+        // Cancelled by the observer, the step is played again on resume
+        return false;
+    }
+    m_levels.merge(played);
+    m_trials_done += count;
+    return true;
+}
+
+const LevelHistogram & Simulation::run(const std::string & path)
+{
+    while (step()) {
+        save(path);
+    }
+    return m_levels;
+}
@@ -1,30 +1,496 @@
 #include "st_petersburg.h"
+#include "parallel.h"
 #include "random_gen.h"
+#include "variance_reduction.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-bool make_flip() {
-    // Heads = [0;0.5), Tails = (0.5; 1], edge = {0.5} to make Heads/Tails = 50%/50%
-    return get_random_number() > 0.5;
+namespace {
+
+// Games played between looks at the observer, small enough for frequent
+// snapshots and large enough to keep the check out of the profile
+constexpr unsigned long SLICE = 1UL << 16;
+
+// Workers of one simulate_levels() call publish their counts here,
+// one of them at a time builds a snapshot for the observer
+class ProgressTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ProgressTracker(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+        : m_runs(runs)
+        , m_bankroll(bankroll)
+        , m_options(options)
+        , m_counts(max_level(bankroll, options.rules) + 1)
+        , m_start(Clock::now())
+        , m_next(m_start + interval())
+    {
+    }
+
+    // Publishes the games of `levels` not published yet, false once the run is cancelled
+    bool report(const LevelHistogram & levels, std::vector<std::uint64_t> & published)
+    {
+        for (unsigned level = 0; level <= levels.level_cap(); ++level) {
+            if (levels.counts()[level] != published[level]) {
+                m_counts[level].fetch_add(levels.counts()[level] - published[level], std::memory_order_relaxed);
+                published[level] = levels.counts()[level];
+            }
+        }
+        if (m_cancelled.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        const auto now = Clock::now();
+        std::unique_lock lock(m_mutex, std::try_to_lock);
+        if (!lock.owns_lock() || now < m_next) {
+            return true;
+        }
+        m_next = now + interval();
+        LevelHistogram snapshot(m_bankroll, m_options.rules);
+        for (unsigned level = 0; level < m_counts.size(); ++level) {
+            snapshot.add(level, m_counts[level].load(std::memory_order_relaxed));
+        }
+        if (!notify(snapshot)) {
+            m_cancelled.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Last snapshot, its answer does not matter any more
+    void finish(const LevelHistogram & result)
+    {
+        const std::lock_guard lock(m_mutex);
+        notify(result);
+    }
+
+private:
+    Clock::duration interval() const
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_options.observe_interval));
+    }
+
+    bool notify(const LevelHistogram & levels) const
+    {
+        Progress progress;
+        progress.trials = levels.runs();
+        progress.runs = m_runs;
+        progress.estimate = RunningStats(levels).estimate(0.95);
+        progress.seconds = std::chrono::duration<double>(Clock::now() - m_start).count();
+        progress.trials_per_second = progress.seconds > 0 ? static_cast<double>(progress.trials) / progress.seconds : 0;
+        return m_options.observer(progress);
+    }
+
+    const unsigned long m_runs;
+    const double m_bankroll;
+    const SimulationOptions & m_options;
+    std::vector<std::atomic<std::uint64_t>> m_counts;
+    std::atomic<bool> m_cancelled{false};
+    std::mutex m_mutex;
+    const Clock::time_point m_start;
+    Clock::time_point m_next;
+};
+
+// Called by a worker between slices of its games, false stops the worker
+class SliceReport
+{
+public:
+    SliceReport(ProgressTracker * tracker, const unsigned level_cap)
+        : m_tracker(tracker)
+        , m_published(tracker ? level_cap + 1 : 0)
+    {
+    }
+
+    bool operator()(const LevelHistogram & levels)
+    {
+        return m_tracker == nullptr || m_tracker->report(levels, m_published);
+    }
+
+private:
+    ProgressTracker * m_tracker;
+    std::vector<std::uint64_t> m_published;
+};
+
+// Unused bits of the last raw word, each bit is one flip with Tails = 1
+template <class Generator>
+class BitReservoir
+{
+public:
+    explicit BitReservoir(Generator & rnd)
+        : m_rnd(rnd)
+    {
+    }
+
+    // Number of Tails before the first Heads, but no more than `limit`
+    unsigned count_tails(const unsigned limit)
+    {
+        unsigned tails = 0;
+        for (;;) {
+            if (m_left == 0) {
+                m_word = m_rnd();
+                m_left = 64;
+            }
+            // Consumed bits are shifted out, zeros above m_left stop the run
+            const unsigned run = ~m_word == 0 ? 64 : static_cast<unsigned>(__builtin_ctzll(~m_word));
+            if (tails + run >= limit) {
+                consume(limit - tails);
+                return limit;
+            }
+            if (run < m_left) {
+                // Tails and the Heads that stopped the game
+                consume(run + 1);
+                return tails + run;
+            }
+            tails += run;
+            m_left = 0;
+        }
+    }
+
+private:
+    void consume(const unsigned bits)
+    {
+        m_word = bits < 64 ? m_word >> bits : 0;
+        m_left -= bits;
+    }
+
+    Generator & m_rnd;
+    std::uint64_t m_word = 0;
+    unsigned m_left = 0;
+};
+
+// Tails before the first Heads of a coin with Tails probability p, drawn at once
+template <class Generator>
+class GeometricTails
+{
+public:
+    GeometricTails(Generator & rnd, const double tails_probability)
+        : m_rnd(rnd)
+        , m_log_tails(std::log(tails_probability))
+    {
+    }
+
+    unsigned count_tails(const unsigned limit)
+    {
+        return geometric_tails(m_rnd.next_double(), m_log_tails, limit);
+    }
+
+private:
+    Generator & m_rnd;
+    double m_log_tails;
+};
+
+// Coin of the classic game, the rules compile to the same loop as a hard-coded game
+struct FairCoin
+{
+    template <class Generator>
+    bool tails(Generator & rnd) const
+    {
+        // Heads = [0;0.5), Tails = (0.5; 1], edge = {0.5} to make Heads/Tails = 50%/50%
+        return rnd.next_double() > 0.5;
+    }
+
+    // Run of Tails from raw bits
+    template <class Generator>
+    BitReservoir<Generator> tails_source(Generator & rnd) const
+    {
+        return BitReservoir<Generator>(rnd);
+    }
+};
+
+struct BiasedCoin
+{
+    double tails_probability;
+
+    template <class Generator>
+    bool tails(Generator & rnd) const
+    {
+        return rnd.next_double() < tails_probability;
+    }
+
+    template <class Generator>
+    GeometricTails<Generator> tails_source(Generator & rnd) const
+    {
+        return GeometricTails<Generator>(rnd, tails_probability);
+    }
+};
+
+// Calls visit(coin) with the coin type of the rules
+template <class Visit>
+void with_coin(const GameRules & rules, const Visit & visit) {
+    if (rules.fair_coin()) {
+        visit(FairCoin{});
+    }
+    else {
+        visit(BiasedCoin{rules.tails_probability});
+    }
 }
 
-double calculate_expected_value(const unsigned long runs, const double bankroll) {
-    // Initial bet-win value
-    const double INITIAL_BET = 2;
-    // Sum of winnings of all runs
-    long double price_to_pay = 0;
+// Level cap known at run time only
+struct DynamicCap
+{
+    unsigned value;
+
+    unsigned operator()() const { return value; }
+};
+
+// Level cap known at compile time
+template <unsigned MaxLevel>
+struct FixedCap
+{
+    constexpr unsigned operator()() const { return MaxLevel; }
+};
+
+// Caps with a kernel of their own: every bankroll up to 2^64
+constexpr unsigned FIXED_CAPS = 64;
+
+// Bound of the loop is a constant for FixedCap
+template <class Coin, class Cap, class Generator>
+unsigned play(const Cap level_cap, Generator & rnd, const Coin & coin) {
+    // Doublings of the initial bet made so far
+    unsigned level = 0;
+    // While doubled bet < bankroll and Tails
+    while (level < level_cap() && coin.tails(rnd)) {
+        // Double our winnings
+        ++level;
+    }
+    return level;
+}
+
+// Calls visit(cap) with FixedCap<level_cap> from a table of kernels, DynamicCap beyond it
+template <class Visit, unsigned... Caps>
+void with_level_cap(const unsigned level_cap, const Visit & visit, std::integer_sequence<unsigned, Caps...>) {
+    using Kernel = void (*)(const Visit &);
+    static constexpr Kernel KERNELS[] = {[](const Visit & v) { v(FixedCap<Caps>{}); }...};
+    if (level_cap < sizeof...(Caps)) {
+        KERNELS[level_cap](visit);
+    }
+    else {
+        visit(DynamicCap{level_cap});
+    }
+}
+
+template <class Visit>
+void with_level_cap(const unsigned level_cap, const Visit & visit) {
+    with_level_cap(level_cap, visit, std::make_integer_sequence<unsigned, FIXED_CAPS>{});
+}
 
-    for (unsigned long int i = 0; i < runs; i++) {
-        // Current winnings before first flip
-        long double current_win = INITIAL_BET;
-        // While doubled bet < bankroll and Tails
-        while (current_win < bankroll && make_flip()) {
-            // Double our winnings
-            current_win *= 2;
+// Simulation core, one instantiation per coin, cap and generator policy,
+// slices do not change the sequence of games
+template <class Coin, class Cap, class Generator>
+void play_games(const unsigned long count, const Engine engine, const Coin & coin, const Cap cap, Generator & rnd, LevelHistogram & levels, SliceReport & report) {
+    const unsigned level_cap = cap();
+    // Bits left from one game are used by the next one
+    auto bits = coin.tails_source(rnd);
+    for (unsigned long done = 0; done < count;) {
+        const unsigned long slice = std::min(SLICE, count - done);
+        if (engine == Engine::Bits) {
+            for (unsigned long i = 0; i < slice; i++) {
+                levels.add(bits.count_tails(level_cap));
+            }
+        }
+        else {
+            for (unsigned long i = 0; i < slice; i++) {
+                levels.add(play(cap, rnd, coin));
+            }
+        }
+        done += slice;
+        if (!report(levels)) {
+            return;
         }
-        // Add current run winnings bounded by bankroll to all
-        price_to_pay += (current_win > bankroll ? bankroll : current_win);
     }
+}
 
+// Seed of the streams of a range of games starting at first_trial
+std::uint64_t stream_seed(const std::uint64_t seed, const SimulationOptions & options) {
+    return options.first_trial == 0 ? seed : mix_seed(seed, options.first_trial);
+}
+
+void simulate_block(const unsigned long first, const unsigned long count, const std::uint64_t seed, const unsigned index, const SimulationOptions & options, ProgressTracker * tracker, LevelHistogram & levels) {
+    SliceReport report(tracker, levels.level_cap());
+    if (options.engine == Engine::Lanes && options.rules.fair_coin()) {
+        play_lanes(count, stream_seed(seed, options), std::uint64_t{index} * LANES, options.lane_isa, levels);
+        report(levels);
+        return;
+    }
+    // Vector lanes flip fair coins only, other coins draw whole runs of Tails instead
+    const Engine engine = options.engine == Engine::Lanes ? Engine::Bits : options.engine;
+    with_coin(options.rules, [&](const auto & coin) {
+        if (options.rng == Rng::Philox) {
+            // Every game has its own counter-based stream
+            SliceReport no_report(nullptr, 0);
+            const std::uint64_t end = options.first_trial + first + count;
+            for (std::uint64_t i = options.first_trial + first; i < end; i++) {
+                Philox4x32 rnd(seed, i);
+                play_games(1, engine, coin, DynamicCap{levels.level_cap()}, rnd, levels, no_report);
+                if ((end - i) % SLICE == 1 && !report(levels)) {
+                    return;
+                }
+            }
+            return;
+        }
+        with_generator(options.rng, stream_seed(seed, options), index, [&](auto & generator) {
+            // Same sequence as drawing from the generator one by one
+            Prefetched rnd(generator);
+            if constexpr (std::is_same_v<std::decay_t<decltype(coin)>, FairCoin>) {
+                with_level_cap(levels.level_cap(), [&](const auto cap) {
+                    play_games(count, engine, coin, cap, rnd, levels, report);
+                });
+            }
+            else {
+                // Kernels per cap are kept to the classic coin to bound the code size
+                play_games(count, engine, coin, DynamicCap{levels.level_cap()}, rnd, levels, report);
+            }
+        });
+    });
+}
+
+// Same distribution of counts as playing every game, in O(log bankroll) draws
+template <class Generator>
+void sample_levels(const unsigned long runs, Generator & rnd, LevelHistogram & levels) {
+    const double tails_probability = levels.rules().tails_probability;
+    std::uint64_t survivors = runs;
+    for (unsigned level = 0; level < levels.level_cap() && survivors > 0; ++level) {
+        // Games with Tails go on to the next level
+        const std::uint64_t tails = std::binomial_distribution<std::uint64_t>(survivors, tails_probability)(rnd);
+        levels.add(level, survivors - tails);
+        survivors = tails;
+    }
+    // The rest reached the bankroll
+    levels.add(levels.level_cap(), survivors);
+}
+
+} // anonymous namespace
+
+double calculate_expected_value(const unsigned long runs, const double bankroll) {
+    return calculate_expected_value(runs, bankroll, SimulationOptions{});
+}
+
+double calculate_expected_value(const unsigned long runs, const double bankroll, const SimulationOptions & options) {
+    if (options.estimator != Estimator::Plain) {
+        return estimate_expected_value(runs, bankroll, options).mean;
+    }
     // Return fair price of entrance if runs > 0, else 0
-    return runs > 0 ? price_to_pay / runs : 0;
+    return simulate_levels(runs, bankroll, options).mean();
+}
+
+Estimate estimate_expected_value(const unsigned long runs, const double bankroll, const SimulationOptions & options) {
+    const double CONFIDENCE = 0.95;
+    switch (options.estimator) {
+    case Estimator::Stratified:
+        return estimate_stratified(runs, bankroll, options, CONFIDENCE);
+    case Estimator::Importance:
+        return estimate_importance(runs, bankroll, options, CONFIDENCE);
+    case Estimator::Hybrid:
+        return estimate_hybrid(runs, bankroll, options, CONFIDENCE);
+    case Estimator::Exact:
+        return make_estimate(exact_expected_value(bankroll, options.rules), 0, 0, CONFIDENCE);
+    case Estimator::Plain:
+        break;
+    }
+    if (options.engine == Engine::Quasi) {
+        return estimate_quasi(runs, bankroll, options, CONFIDENCE);
+    }
+    return RunningStats(simulate_levels(runs, bankroll, options)).estimate(CONFIDENCE);
+}
+
+LevelHistogram simulate_levels(const unsigned long runs, const double bankroll, const SimulationOptions & options) {
+    const std::uint64_t seed = options.seed ? *options.seed : make_random_seed();
+    std::optional<ProgressTracker> tracker;
+    if (options.observer) {
+        tracker.emplace(runs, bankroll, options);
+    }
+    if (options.engine == Engine::Binomial || options.engine == Engine::Quasi) {
+        LevelHistogram result(bankroll, options.rules);
+        if (options.engine == Engine::Quasi) {
+            result = quasi_levels(runs, bankroll, options);
+        }
+        else {
+            const bool by_trial = options.rng == Rng::Philox;
+            with_generator(options.rng, by_trial ? seed : stream_seed(seed, options), by_trial ? options.first_trial : 0, [&](auto & rnd) {
+                sample_levels(runs, rnd, result);
+            });
+        }
+        if (tracker) {
+            tracker->finish(result);
+        }
+        return result;
+    }
+    const unsigned threads = resolve_threads(runs, options.threads);
+
+    // Every worker owns a contiguous block of runs, its own random stream and histogram
+    std::vector<LevelHistogram> partial(threads, LevelHistogram(bankroll, options.rules));
+    run_workers(threads, [&](const unsigned index) {
+        simulate_block(part_begin(runs, threads, index), part_size(runs, threads, index), seed, index, options, tracker ? &*tracker : nullptr, partial[index]);
+    });
+
+    // Integer counts merge exactly in any order
+    LevelHistogram result(bankroll, options.rules);
+    for (const auto & levels : partial) {
+        result.merge(levels);
+    }
+    if (tracker) {
+        tracker->finish(result);
+    }
+    return result;
+}
+
+std::vector<double> calculate_expected_values(const unsigned long runs, const std::vector<double> & bankrolls, const SimulationOptions & options) {
+    std::vector<double> result;
+    if (bankrolls.empty()) {
+        return result;
+    }
+    const auto levels = simulate_batch({{runs, *std::max_element(bankrolls.begin(), bankrolls.end())}}, options).front();
+    result.reserve(bankrolls.size());
+    for (const auto bankroll : bankrolls) {
+        result.push_back(levels.with_bankroll(bankroll).mean());
+    }
+    return result;
+}
+
+Estimate estimate_expected_value(const double bankroll, const Precision & precision, const SimulationOptions & options) {
+    if (!(precision.absolute_error > 0) && !(precision.relative_error > 0)) {
+        throw std::invalid_argument("Precision needs a positive absolute or relative error");
+    }
+    SimulationOptions chunk_options = options;
+    chunk_options.seed = options.seed ? *options.seed : make_random_seed();
+    // Observer sees the whole run once per chunk
+    chunk_options.observer = nullptr;
+    const double z = normal_quantile(0.5 + precision.confidence / 2);
+    const auto start = std::chrono::steady_clock::now();
+
+    RunningStats stats;
+    unsigned long done = 0;
+    while (done < precision.max_runs) {
+        const unsigned long runs = std::min(std::max(precision.chunk, 1UL), precision.max_runs - done);
+        chunk_options.first_trial = options.first_trial + done;
+        stats.merge(RunningStats(simulate_levels(runs, bankroll, chunk_options)));
+        done += runs;
+
+        if (options.observer) {
+            Progress progress;
+            progress.trials = done;
+            progress.runs = precision.max_runs;
+            progress.estimate = stats.estimate(0.95);
+            progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            progress.trials_per_second = progress.seconds > 0 ? done / progress.seconds : 0;
+            if (!options.observer(progress)) {
+                break;
+            }
+        }
+
+        const double half_width = z * stats.std_error();
+        if (half_width <= precision.absolute_error || half_width <= precision.relative_error * std::abs(stats.mean())) {
+            break;
+        }
+    }
+    return stats.estimate(precision.confidence);
 }
@@ -0,0 +1,274 @@
+#include "variance_reduction.h"
+#include "level_histogram.h"
+#include "parallel.h"
+#include "quasi_random.h"
+#include "random_gen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Level of a fair game given w = P(level >= result) from (0;1], i.e. floor(-log2(w))
+unsigned fair_level(const double w, const unsigned level_cap)
+{
+    int exponent;
+    const double fraction = std::frexp(w, &exponent);
+    const int level = fraction == 0.5 ? 1 - exponent : -exponent;
+    return std::min(static_cast<unsigned>(level), level_cap);
+}
+
+// Level of a game with Tails probability q given w = P(level >= result) from (0;1]
+unsigned biased_level(const double w, const double log_q, const unsigned level_cap)
+{
+    const double level = std::floor(std::log(w) / log_q);
+    return level < level_cap ? static_cast<unsigned>(level) : level_cap;
+}
+
+// Calls play(replicate, games, rnd) for every replicate on the worker threads,
+// every replicate gets its own generator keyed by seed and replicate index
+template <class Play>
+void for_each_replicate(const unsigned long runs, const unsigned replicates, const SimulationOptions & options, const Play & play)
+{
+    const std::uint64_t seed = options.seed ? *options.seed : make_random_seed();
+    const unsigned threads = resolve_threads(replicates, options.threads);
+    run_workers(threads, [&](const unsigned index) {
+        for (unsigned replicate = index; replicate < replicates; replicate += threads) {
+            const unsigned long games = part_size(runs, replicates, replicate);
+            const std::uint64_t stream = options.first_trial + replicate;
+            if (options.rng == Rng::Philox) {
+                Philox4x32 rnd(seed, stream);
+                play(replicate, games, rnd);
+            }
+            else {
+                with_generator(options.rng, mix_seed(seed, stream), 0, [&](auto & rnd) {
+                    play(replicate, games, rnd);
+                });
+            }
+        }
+    });
+}
+
+void require_classic_rules(const SimulationOptions & options)
+{
+    if (!options.rules.standard()) {
+        throw std::invalid_argument("Variance-reduced estimators play the classic game only");
+    }
+}
+
+unsigned resolve_replicates(const unsigned long runs, const unsigned requested)
+{
+    return static_cast<unsigned>(std::max(std::min<unsigned long>(requested, runs), 1UL));
+}
+
+double variance_reduction(const double plain_variance, const double std_error, const unsigned long runs)
+{
+    const double variance = std_error * std_error * runs;
+    if (variance > 0) {
+        return plain_variance / variance;
+    }
+    return plain_variance > 0 ? std::numeric_limits<double>::infinity() : 1;
+}
+
+// Second moment of the importance sampling estimator for Tails probability q
+double importance_second_moment(const LevelHistogram & payouts, const double q)
+{
+    const unsigned level_cap = payouts.level_cap();
+    double result = 0;
+    for (unsigned level = 0; level <= level_cap; ++level) {
+        const double p = level_probability(level, level_cap);
+        const double biased = std::pow(q, level) * (level < level_cap ? 1 - q : 1);
+        const double weighted = payouts.payout(level) * p;
+        result += weighted * weighted / biased;
+    }
+    return result;
+}
+
+// Games of every replicate of Engine::Quasi, each replicate scrambles the points on its own
+std::vector<LevelHistogram> quasi_replicates(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+{
+    const unsigned replicates = resolve_replicates(runs, options.replicates);
+    const GameRules & rules = options.rules;
+    const double log_tails = std::log(rules.tails_probability);
+    std::vector<LevelHistogram> levels(replicates, LevelHistogram(bankroll, rules));
+    for_each_replicate(runs, replicates, options, [&](const unsigned replicate, const unsigned long games, auto & rnd) {
+        auto & histogram = levels[replicate];
+        const ScrambledVanDerCorput points(rnd());
+        const unsigned level_cap = histogram.level_cap();
+        if (rules.fair_coin()) {
+            for (unsigned long j = 0; j < games; ++j) {
+                histogram.add(points.leading_zeros(j, level_cap));
+            }
+        }
+        else {
+            for (unsigned long j = 0; j < games; ++j) {
+                histogram.add(biased_level(1 - points(j), log_tails, level_cap));
+            }
+        }
+    });
+    return levels;
+}
+
+} // anonymous namespace
+
+double exact_expected_value(const double bankroll)
+{
+    return exact_expected_value(bankroll, GameRules{});
+}
+
+double exact_expected_value(const double bankroll, const GameRules & rules)
+{
+    const LevelHistogram payouts(bankroll, rules);
+    long double result = 0;
+    for (unsigned level = 0; level <= payouts.level_cap(); ++level) {
+        result += static_cast<long double>(level_probability(level, payouts.level_cap(), rules.tails_probability)) * payouts.payout(level);
+    }
+    return static_cast<double>(result);
+}
+
+double payout_variance(const double bankroll)
+{
+    const LevelHistogram payouts(bankroll);
+    const unsigned level_cap = payouts.level_cap();
+    long double mean = 0;
+    long double second_moment = 0;
+    for (unsigned level = 0; level <= level_cap; ++level) {
+        const long double p = level_probability(level, level_cap);
+        const long double x = payouts.payout(level);
+        mean += p * x;
+        second_moment += p * x * x;
+    }
+    return static_cast<double>(second_moment - mean * mean);
+}
+
+double optimal_importance_tails(const double bankroll)
+{
+    const LevelHistogram payouts(bankroll);
+    if (payouts.level_cap() == 0) {
+        return 0.5;
+    }
+    // Golden-section search, the second moment is unimodal in q
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double low = 0.5;
+    double high = 1 - 1e-9;
+    for (int i = 0; i < 100; ++i) {
+        const double left = high - ratio * (high - low);
+        const double right = low + ratio * (high - low);
+        if (importance_second_moment(payouts, left) < importance_second_moment(payouts, right)) {
+            high = right;
+        }
+        else {
+            low = left;
+        }
+    }
+    return (low + high) / 2;
+}
+
+Estimate estimate_stratified(const unsigned long runs, const double bankroll, const SimulationOptions & options, const double confidence)
+{
+    require_classic_rules(options);
+    const unsigned replicates = resolve_replicates(runs, options.replicates);
+    std::vector<LevelHistogram> levels(replicates, LevelHistogram(bankroll));
+    for_each_replicate(runs, replicates, options, [&](const unsigned replicate, const unsigned long games, auto & rnd) {
+        auto & histogram = levels[replicate];
+        for (unsigned long j = 0; j < games; ++j) {
+            // Counted from the top stratum so that w never rounds to 0
+            const double w = (static_cast<double>(games - 1 - j) + (1 - rnd.next_double())) / games;
+            histogram.add(fair_level(w, histogram.level_cap()));
+        }
+    });
+
+    // Replicate means are independent, their spread gives the error
+    LevelHistogram total(bankroll);
+    RunningStats means;
+    for (const auto & histogram : levels) {
+        total.merge(histogram);
+        means.add(histogram.mean());
+    }
+    auto result = make_estimate(total.mean(), means.std_error(), runs, confidence);
+    result.variance_reduction = variance_reduction(payout_variance(bankroll), result.std_error, runs);
+    return result;
+}
+
+Estimate estimate_importance(const unsigned long runs, const double bankroll, const SimulationOptions & options, const double confidence)
+{
+    require_classic_rules(options);
+    const double q = options.importance_tails ? *options.importance_tails : optimal_importance_tails(bankroll);
+    if (!(q > 0 && q < 1)) {
+        throw std::invalid_argument("Importance tails probability must be from (0;1)");
+    }
+    const double log_q = std::log(q);
+    const unsigned replicates = resolve_replicates(runs, options.replicates);
+    std::vector<LevelHistogram> levels(replicates, LevelHistogram(bankroll));
+    for_each_replicate(runs, replicates, options, [&](const unsigned replicate, const unsigned long games, auto & rnd) {
+        auto & histogram = levels[replicate];
+        for (unsigned long j = 0; j < games; ++j) {
+            histogram.add(biased_level(1 - rnd.next_double(), log_q, histogram.level_cap()));
+        }
+    });
+
+    LevelHistogram total(bankroll);
+    for (const auto & histogram : levels) {
+        total.merge(histogram);
+    }
+    // Weighted payout depends on the level only
+    RunningStats weighted;
+    const unsigned level_cap = total.level_cap();
+    for (unsigned level = 0; level <= level_cap; ++level) {
+        const double biased = std::pow(q, level) * (level < level_cap ? 1 - q : 1);
+        weighted.add(total.payout(level) * level_probability(level, level_cap) / biased, total.counts()[level]);
+    }
+    auto result = weighted.estimate(confidence);
+    result.variance_reduction = variance_reduction(payout_variance(bankroll), result.std_error, runs);
+    return result;
+}
+
+Estimate estimate_hybrid(const unsigned long runs, const double bankroll, const SimulationOptions & options, const double confidence)
+{
+    require_classic_rules(options);
+    const LevelHistogram payouts(bankroll);
+    const unsigned depth = std::min(options.hybrid_levels, payouts.level_cap());
+    // Games are stopped after `depth` doublings, the last level means "depth or more"
+    const auto shallow = simulate_levels(runs, std::min(bankroll, std::ldexp(2.0, static_cast<int>(depth))), options);
+
+    long double tail = 0;
+    for (unsigned level = depth; level <= payouts.level_cap(); ++level) {
+        tail += static_cast<long double>(level_probability(level, payouts.level_cap())) * payouts.payout(level);
+    }
+
+    RunningStats simulated;
+    for (unsigned level = 0; level < depth; ++level) {
+        simulated.add(payouts.payout(level), shallow.counts()[level]);
+    }
+    simulated.add(0, shallow.counts()[depth]);
+
+    auto result = make_estimate(simulated.mean() + static_cast<double>(tail), simulated.std_error(), runs, confidence);
+    result.variance_reduction = variance_reduction(payout_variance(bankroll), result.std_error, runs);
+    return result;
+}
+
+LevelHistogram quasi_levels(const unsigned long runs, const double bankroll, const SimulationOptions & options)
+{
+    LevelHistogram total(bankroll, options.rules);
+    for (const auto & histogram : quasi_replicates(runs, bankroll, options)) {
+        total.merge(histogram);
+    }
+    return total;
+}
+
+Estimate estimate_quasi(const unsigned long runs, const double bankroll, const SimulationOptions & options, const double confidence)
+{
+    // Points of a replicate are not independent, only the replicate means are
+    LevelHistogram total(bankroll, options.rules);
+    RunningStats means;
+    for (const auto & histogram : quasi_replicates(runs, bankroll, options)) {
+        total.merge(histogram);
+        means.add(histogram.mean());
+    }
+    auto result = make_estimate(total.mean(), means.std_error(), runs, confidence);
+    result.variance_reduction = variance_reduction(total.variance(), result.std_error, runs);
+    return result;
+}
@@ -1,4 +1,7 @@
+#include "random_gen.h"
 #include "st_petersburg.h"
+#include "test_support.h"
+#include "variance_reduction.h"
 
 #include <gtest/gtest.h>
 
@@ -11,12 +14,220 @@ TEST(MonteCarloTest, zero_iterations)
 
 TEST(MonteCarloTest, small_bank)
 {
-    EXPECT_NEAR(7.56, calculate_expected_value(10000, 100), 5e-1);
-    EXPECT_NEAR(7.56, calculate_expected_value(10000000, 100), 5e-2);
+    // Unseeded games: only what holds for every seed
+    const double value = calculate_expected_value(10000, 100);
+    EXPECT_GE(value, 2);
+    EXPECT_LE(value, 100);
+    EXPECT_NEAR(7.5625, payout_moments(100).mean, 1e-12);
+    EXPECT_TRUE(near_expected(simulate_levels(200000, 100, seeded_options())));
 }
 
 TEST(MonteCarloTest, medium_bank)
 {
-    EXPECT_NEAR(20.91, calculate_expected_value(100000000, 1000000), 5e-1);
-    EXPECT_NEAR(20.91, calculate_expected_value(1000000000, 1000000), 1e-1);
+    EXPECT_TRUE(near_expected(simulate_levels(200000, 1000000, seeded_options())));
+    // Aggregate engine, exact and hybrid estimators stand in for a 1e9 games run
+    SimulationOptions options = seeded_options(Engine::Binomial);
+    EXPECT_NEAR(20.91, calculate_expected_value(1000000000000, 1000000, options), 2e-2);
+    options.estimator = Estimator::Exact;
+    EXPECT_NEAR(20.91, calculate_expected_value(0, 1000000, options), 1e-2);
+    options = seeded_options();
+    options.estimator = Estimator::Hybrid;
+    EXPECT_NEAR(20.91, calculate_expected_value(1000000, 1000000, options), 1e-1);
+}
+
+TEST(MonteCarloTest, parallel_reproducible)
+{
+    SimulationOptions options;
+    options.seed = 42;
+    for (const unsigned threads : {1U, 3U, 8U}) {
+        options.threads = threads;
+        EXPECT_EQ(calculate_expected_value(100000, 1000, options), calculate_expected_value(100000, 1000, options));
+    }
+}
+
+TEST(MonteCarloTest, parallel_small_bank)
+{
+    SimulationOptions options = seeded_options();
+    options.threads = 4;
+    EXPECT_TRUE(near_expected(simulate_levels(200000, 100, options)));
+    options.threads = 100;
+    EXPECT_DOUBLE_EQ(2, calculate_expected_value(3, 2, options));
+}
+
+TEST(MonteCarloTest, philox_known_answer)
+{
+    // Known-answer vectors from the Random123 distribution
+    EXPECT_EQ((Philox4x32::Counter{0x6627E8D5, 0xE169C58D, 0xBC57AC4C, 0x9B00DBD8}),
+              Philox4x32::block({0, 0, 0, 0}, {0, 0}));
+    EXPECT_EQ((Philox4x32::Counter{0x408F276D, 0x41C83B0E, 0xA20BC7C6, 0x6D5451FD}),
+              Philox4x32::block({0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}, {0xFFFFFFFF, 0xFFFFFFFF}));
+    EXPECT_EQ((Philox4x32::Counter{0xD16CFE09, 0x94FDCCEB, 0x5001E420, 0x24126EA1}),
+              Philox4x32::block({0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344}, {0xA4093822, 0x299F31D0}));
+}
+
+TEST(MonteCarloTest, philox_independent_of_threads)
+{
+    SimulationOptions options;
+    options.seed = 7;
+    options.rng = Rng::Philox;
+    options.threads = 1;
+    const double reference = calculate_expected_value(50000, 1e6, options);
+    for (const unsigned threads : {2U, 5U, 16U}) {
+        options.threads = threads;
+        EXPECT_EQ(reference, calculate_expected_value(50000, 1e6, options));
+    }
+    EXPECT_TRUE(near_expected(simulate_levels(100000, 100, options)));
+}
+
+TEST(MonteCarloTest, bits_engine)
+{
+    SimulationOptions options = seeded_options(Engine::Bits);
+    EXPECT_TRUE(near_expected(simulate_levels(200000, 100, options)));
+    EXPECT_TRUE(near_expected(simulate_levels(200000, 1000000, options)));
+    // Bankroll below initial bet
+    EXPECT_DOUBLE_EQ(1.5, calculate_expected_value(1000, 1.5, options));
+    EXPECT_DOUBLE_EQ(2, calculate_expected_value(1000, 2, options));
+
+    options.seed = 3;
+    options.rng = Rng::Philox;
+    options.threads = 1;
+    const double reference = calculate_expected_value(100000, 1000, options);
+    options.threads = 7;
+    EXPECT_EQ(reference, calculate_expected_value(100000, 1000, options));
+}
+
+TEST(MonteCarloTest, binomial_engine)
+{
+    SimulationOptions options = seeded_options(Engine::Binomial);
+    EXPECT_NEAR(7.5625, calculate_expected_value(1000000000000, 100, options), 1e-3);
+    EXPECT_NEAR(20.907, calculate_expected_value(1000000000000, 1000000, options), 2e-2);
+    EXPECT_DOUBLE_EQ(0, calculate_expected_value(0, 100, options));
+
+    options.seed = 5;
+    const auto levels = simulate_levels(1000000, 1000, options);
+    EXPECT_EQ(1000000U, levels.runs());
+    EXPECT_EQ(levels.counts(), simulate_levels(1000000, 1000, options).counts());
+    // Half of the games stop at the first flip
+    EXPECT_NEAR(500000, levels.counts()[0], 5 * 500);
+}
+
+TEST(MonteCarloTest, bulk_random_numbers)
+{
+    double numbers[1000];
+    fill_random_numbers(numbers, 1000);
+    for (const double x : numbers) {
+        EXPECT_GE(x, 0);
+        EXPECT_LT(x, 1);
+    }
+    std::uint64_t words[2];
+    fill_random_bits(words, 2);
+    EXPECT_NE(words[0], words[1]);
+    const double x = get_random_number();
+    EXPECT_GE(x, 0);
+    EXPECT_LT(x, 1);
+
+    // Prefetching does not change the sequence
+    Xoshiro256 engine(1);
+    Xoshiro256 copy(1);
+    Prefetched<Xoshiro256, 16> block(copy);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(engine.next_double(), block.next_double());
+    }
+}
+
+TEST(MonteCarloTest, generator_policies)
+{
+    // Output of the reference pcg64 demo seeded with (42, 54)
+    Pcg64 pcg(42, 54);
+    EXPECT_EQ(0x86B1DA1D72062B68U, pcg());
+    EXPECT_EQ(0x1304AA46C9853D39U, pcg());
+    EXPECT_EQ(0xA3670E9E0DD50358U, pcg());
+    EXPECT_NE(Pcg64(42, 54)(), Pcg64(42, 55)());
+
+    for (const auto rng : {Rng::Xoshiro, Rng::Philox, Rng::Pcg64, Rng::Mt19937}) {
+        const auto options = seeded_options(Engine::Bits, rng, 43);
+        EXPECT_TRUE(near_expected(simulate_levels(200000, 100, options)));
+        EXPECT_EQ(calculate_expected_value(1000, 100, options), calculate_expected_value(1000, 100, options));
+    }
+}
+
+TEST(MonteCarloTest, observer)
+{
+    SimulationOptions options;
+    options.seed = 11;
+    options.threads = 2;
+    const auto plain = simulate_levels(300000, 1000, options);
+
+    std::vector<Progress> snapshots;
+    options.observe_interval = 0;
+    options.observer = [&](const Progress & progress) {
+        snapshots.push_back(progress);
+        return true;
+    };
+    // Observing does not change the games
+    EXPECT_EQ(plain.counts(), simulate_levels(300000, 1000, options).counts());
+    ASSERT_GT(snapshots.size(), 2U);
+    EXPECT_EQ(300000U, snapshots.back().trials);
+    EXPECT_EQ(300000U, snapshots.back().runs);
+    EXPECT_DOUBLE_EQ(plain.mean(), snapshots.back().estimate.mean);
+    for (std::size_t i = 1; i < snapshots.size(); ++i) {
+        EXPECT_LE(snapshots[i - 1].trials, snapshots[i].trials);
+    }
+}
+
+TEST(MonteCarloTest, observer_cancels)
+{
+    SimulationOptions options;
+    options.seed = 11;
+    options.observe_interval = 0;
+    options.observer = [](const Progress & progress) {
+        return progress.trials < 200000;
+    };
+    for (const auto rng : {Rng::Xoshiro, Rng::Philox}) {
+        options.rng = rng;
+        const auto levels = simulate_levels(100000000, 1000, options);
+        EXPECT_GE(levels.runs(), 200000U);
+        EXPECT_LT(levels.runs(), 100000000U);
+    }
+}
+
+TEST(MonteCarloTest, game_rules)
+{
+    SimulationOptions options;
+    options.seed = 5;
+    options.rules.tails_probability = 0.4;
+    options.rules.multiplier = 2.5;
+    options.rules.initial_bet = 1;
+    const double exact = exact_expected_value(1e6, options.rules);
+    // Every level below the cap adds 2.5^k * 0.4^k * 0.6 = 0.6, as in the classic game
+    EXPECT_GT(exact, 10);
+    EXPECT_DOUBLE_EQ(exact, payout_moments(1e6, options.rules).mean);
+    EXPECT_TRUE(near_expected(simulate_levels(200000, 1e6, options)));
+
+    // At most 4 Tails and no bankroll limit: levels 0-3 add 1 each, level 4 adds 32 / 16
+    options.rules = GameRules{};
+    options.rules.cap = CapPolicy::Rounds;
+    options.rules.max_rounds = 4;
+    EXPECT_DOUBLE_EQ(1 + 1 + 1 + 1 + 2, exact_expected_value(1, options.rules));
+    EXPECT_NEAR(6, calculate_expected_value(200000, 1, options), 0.1);
+
+    options.estimator = Estimator::Stratified;
+    EXPECT_THROW(estimate_expected_value(1000, 100, options), std::invalid_argument);
+}
+
+TEST(MonteCarloTest, level_cap_kernels)
+{
+    SimulationOptions options;
+    options.seed = 9;
+    options.threads = 1;
+    // Caps 0, 62 and 63 have kernels of their own, 99 takes the generic loop
+    for (const double bankroll : {1.0, 0x1p63, 0x1p64, 0x1p100}) {
+        for (const auto engine : {Engine::Flip, Engine::Bits}) {
+            options.engine = engine;
+            const auto levels = simulate_levels(100000, bankroll, options);
+            EXPECT_EQ(100000U, levels.runs());
+            EXPECT_EQ(max_level(bankroll), levels.level_cap());
+            EXPECT_NEAR(0.5, static_cast<double>(levels.counts()[0]) / 100000, bankroll > 1 ? 0.01 : 0.5);
+        }
+    }
 }
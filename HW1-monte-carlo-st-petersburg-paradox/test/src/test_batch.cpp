@@ -0,0 +1,73 @@
+#include "st_petersburg.h"
+#include "work_stealing.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+TEST(BatchTest, every_task_once)
+{
+    const std::uint32_t tasks = 10000;
+    std::unique_ptr<std::atomic<unsigned>[]> runs(new std::atomic<unsigned>[tasks]());
+    // Uneven tasks: the workers owning the cheap ones steal the rest
+    run_stealing(tasks, 4, [&](const std::uint32_t task) {
+        volatile unsigned spin = 0;
+        for (unsigned i = 0; i < (task < tasks / 4 ? 1000U : 1U); ++i) {
+            spin = spin + 1;
+        }
+        runs[task].fetch_add(1);
+    });
+    for (std::uint32_t task = 0; task < tasks; ++task) {
+        ASSERT_EQ(1U, runs[task].load()) << task;
+    }
+    run_stealing(0, 4, [](std::uint32_t) { FAIL(); });
+}
+
+TEST(BatchTest, mixed_jobs)
+{
+    SimulationOptions options;
+    options.seed = 21;
+    options.rng = Rng::Philox;
+    const std::vector<BatchJob> jobs = {{200000, 1000000}, {1000, 100}, {0, 1000}, {54321, 1000}};
+    const auto levels = simulate_batch(jobs, options, 10000);
+    ASSERT_EQ(jobs.size(), levels.size());
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        // Philox chunks are the games of a single run
+        EXPECT_EQ(simulate_levels(jobs[i].runs, jobs[i].bankroll, options).counts(), levels[i].counts());
+    }
+    EXPECT_TRUE(simulate_batch({}, options).empty());
+}
+
+TEST(BatchTest, independent_of_threads)
+{
+    SimulationOptions options;
+    options.seed = 8;
+    const std::vector<BatchJob> jobs = {{100000, 1000}, {30000, 64}};
+    for (const auto engine : {Engine::Flip, Engine::Bits, Engine::Lanes, Engine::Binomial}) {
+        options.engine = engine;
+        options.threads = 1;
+        const auto one = simulate_batch(jobs, options, 7000);
+        options.threads = 3;
+        const auto three = simulate_batch(jobs, options, 7000);
+        EXPECT_EQ(one[0].counts(), three[0].counts());
+        EXPECT_EQ(one[1].counts(), three[1].counts());
+        EXPECT_EQ(30000U, three[1].runs());
+    }
+}
+
+TEST(BatchTest, aggregate_sweep)
+{
+    SimulationOptions options;
+    options.seed = 12;
+    options.engine = Engine::Binomial;
+    // A job of the aggregate engine is one chunk, its cost does not grow with the runs
+    const auto start = std::chrono::steady_clock::now();
+    const auto values = calculate_expected_values(1000000000000, {100, 1000000}, options);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    ASSERT_EQ(2U, values.size());
+    EXPECT_NEAR(7.5625, values[0], 1e-3);
+    EXPECT_NEAR(20.907, values[1], 2e-2);
+    EXPECT_EQ(simulate_levels(100000000, 1000, options).counts(), simulate_batch({{100000000, 1000}}, options, 1000).front().counts());
+}
@@ -0,0 +1,47 @@
+#include "distribution_report.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+TEST(DistributionReportTest, summary)
+{
+    LevelHistogram levels(100);
+    // 500 games pay 2, 300 pay 4, 195 pay 8, 4 pay 64 and 1 hits the bankroll
+    levels.add(0, 500);
+    levels.add(1, 300);
+    levels.add(2, 195);
+    levels.add(5, 4);
+    levels.add(6, 1);
+    const auto report = make_distribution_report(levels);
+    EXPECT_EQ(1000U, report.runs);
+    EXPECT_DOUBLE_EQ(levels.mean(), report.mean);
+    EXPECT_DOUBLE_EQ(2, report.median);
+    EXPECT_DOUBLE_EQ(8, report.p99);
+    EXPECT_DOUBLE_EQ(64, report.p999);
+    EXPECT_DOUBLE_EQ(0.001, report.cap_probability);
+    ASSERT_EQ(7U, report.levels.size());
+    EXPECT_DOUBLE_EQ(100, report.levels[6].payout);
+
+    std::ostringstream csv;
+    write_report_csv(csv, report);
+    EXPECT_EQ(0U, csv.str().find("bankroll,runs,mean"));
+    EXPECT_NE(std::string::npos, csv.str().find("\n100,1000,"));
+
+    std::ostringstream json;
+    write_report_json(json, report);
+    EXPECT_NE(std::string::npos, json.str().find("\"p999\": 64,"));
+    EXPECT_NE(std::string::npos, json.str().find("{\"level\": 6, \"payout\": 100, \"count\": 1}"));
+}
+
+TEST(DistributionReportTest, simulated)
+{
+    SimulationOptions options;
+    options.seed = 41;
+    const auto report = distribution_report(1000000, 1000000, options);
+    EXPECT_DOUBLE_EQ(2, report.median);
+    // P(payout > 2^6) = 2^-6 > 1% > P(payout > 2^7), P(payout > 2^9) > 0.1% > P(payout > 2^10)
+    EXPECT_DOUBLE_EQ(128, report.p99);
+    EXPECT_DOUBLE_EQ(1024, report.p999);
+    EXPECT_NEAR(0x1p-19, report.cap_probability, 5 * report.cap_probability_error);
+}
@@ -0,0 +1,83 @@
+#include "result_cache.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <tuple>
+#include <vector>
+
+namespace {
+
+struct KnownAnswer
+{
+    Engine engine;
+    Rng rng;
+    std::vector<std::uint64_t> counts;
+};
+
+} // anonymous namespace
+
+TEST(EngineTest, known_answers)
+{
+    // Games per level of simulate_levels(1000, 64) with seed 2024 on 2 threads.
+    // A change here changes the games of every seed: bump ENGINE_VERSION.
+    // Engine::Lanes has its own generators whatever the rng, Engine::Binomial is left out:
+    // std::binomial_distribution differs between standard libraries
+    const std::vector<KnownAnswer> answers = {
+        {Engine::Flip, Rng::Xoshiro, {492, 247, 126, 77, 21, 37}},
+        {Engine::Bits, Rng::Xoshiro, {512, 238, 123, 71, 30, 26}},
+        {Engine::Lanes, Rng::Xoshiro, {493, 268, 114, 68, 28, 29}},
+        {Engine::Quasi, Rng::Xoshiro, {500, 251, 124, 63, 31, 31}},
+        {Engine::Flip, Rng::Philox, {503, 235, 152, 56, 21, 33}},
+        {Engine::Bits, Rng::Philox, {496, 249, 147, 48, 26, 34}},
+        {Engine::Quasi, Rng::Philox, {498, 250, 126, 63, 31, 32}},
+        {Engine::Flip, Rng::Pcg64, {503, 263, 123, 61, 29, 21}},
+        {Engine::Bits, Rng::Pcg64, {487, 262, 115, 63, 28, 45}},
+        {Engine::Quasi, Rng::Pcg64, {501, 250, 123, 63, 31, 32}},
+        {Engine::Flip, Rng::Mt19937, {487, 239, 155, 62, 25, 32}},
+        {Engine::Bits, Rng::Mt19937, {490, 245, 135, 72, 37, 21}},
+        {Engine::Quasi, Rng::Mt19937, {501, 248, 127, 62, 31, 31}},
+    };
+    for (const auto & answer : answers) {
+        const auto options = seeded_options(answer.engine, answer.rng, 2024);
+        EXPECT_EQ(answer.counts, simulate_levels(1000, 64, options).counts())
+            << "engine " << static_cast<int>(answer.engine) << ", rng " << static_cast<int>(answer.rng);
+    }
+    EXPECT_EQ(1U, ENGINE_VERSION);
+}
+
+// Every engine with every generator against the exact distribution
+class EngineMatrixTest : public ::testing::TestWithParam<std::tuple<Engine, Rng>>
+{
+};
+
+TEST_P(EngineMatrixTest, matches_distribution)
+{
+    const auto [engine, rng] = GetParam();
+    const auto options = seeded_options(engine, rng);
+    for (const double bankroll : {100.0, 1e6}) {
+        const auto levels = simulate_levels(100000, bankroll, options);
+        EXPECT_EQ(100000U, levels.runs());
+        EXPECT_TRUE(near_expected(levels));
+        EXPECT_TRUE(levels_distributed(levels));
+        // Same seed, same games
+        EXPECT_EQ(levels.counts(), simulate_levels(100000, bankroll, options).counts());
+    }
+    EXPECT_NE(simulate_levels(10000, 1e6, options).counts(), simulate_levels(10000, 1e6, seeded_options(engine, rng, 2)).counts());
+}
+
+TEST_P(EngineMatrixTest, biased_coin)
+{
+    const auto [engine, rng] = GetParam();
+    auto options = seeded_options(engine, rng);
+    options.rules.tails_probability = 0.4;
+    options.rules.multiplier = 2.5;
+    options.rules.initial_bet = 1;
+    const auto levels = simulate_levels(20000, 1e6, options);
+    EXPECT_TRUE(near_expected(levels));
+    EXPECT_TRUE(levels_distributed(levels));
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, EngineMatrixTest,
+                         ::testing::Combine(::testing::Values(Engine::Flip, Engine::Bits, Engine::Lanes, Engine::Binomial, Engine::Quasi),
+                                            ::testing::Values(Rng::Xoshiro, Rng::Philox, Rng::Pcg64, Rng::Mt19937)));
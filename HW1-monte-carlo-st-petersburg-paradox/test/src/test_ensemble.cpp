@@ -0,0 +1,83 @@
+#include "ensemble.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+TEST(EnsembleTest, single_game_ruin)
+{
+    SimulationOptions options;
+    options.seed = 2;
+    CasinoModel model;
+    model.capital = 16;
+    model.fee = 0;
+    model.max_games = 1;
+    // Win above 16 takes four Tails in a row
+    const auto result = simulate_ensemble(40000, model, options);
+    EXPECT_EQ(40000U, result.histories);
+    EXPECT_NEAR(0.0625, result.ruin_probability.mean, 5 * result.ruin_probability.std_error);
+    EXPECT_EQ(result.ruin_times.size(), static_cast<std::size_t>(result.ruin_probability.mean * 40000 + 0.5));
+    EXPECT_EQ(1U, result.ruin_time_quantile(1));
+    // Survivors paid 2, 4, 8 or 16 out of 16
+    EXPECT_NEAR(16 - 4 / (15.0 / 16), result.mean_final_capital, 0.1);
+
+    // A win of the whole bankroll is paid
+    options.rules.cap = CapPolicy::Rounds;
+    options.rules.max_rounds = 3;
+    EXPECT_TRUE(simulate_ensemble(1000, model, options).ruin_times.empty());
+}
+
+TEST(EnsembleTest, fee_above_every_win)
+{
+    SimulationOptions options;
+    options.seed = 3;
+    options.rules.cap = CapPolicy::Rounds;
+    options.rules.max_rounds = 2;
+    CasinoModel model;
+    model.capital = 100;
+    model.fee = 10;
+    model.max_games = 1000;
+    // Wins are 2, 4 or 8 with mean 1 + 1 + 2, the casino only grows
+    const auto result = simulate_ensemble(1000, model, options);
+    EXPECT_TRUE(result.ruin_times.empty());
+    EXPECT_DOUBLE_EQ(0, result.ruin_probability.mean);
+    EXPECT_EQ(0U, result.ruin_time_quantile(0.5));
+    EXPECT_NEAR(100 + 1000 * 6.0, result.mean_final_capital, 10);
+}
+
+TEST(EnsembleTest, independent_of_threads)
+{
+    SimulationOptions options;
+    options.seed = 4;
+    CasinoModel model;
+    model.capital = 1000;
+    model.fee = 8;
+    model.max_games = 1000;
+    options.threads = 1;
+    const auto one = simulate_ensemble(1000, model, options);
+    options.threads = 3;
+    const auto three = simulate_ensemble(1000, model, options);
+    EXPECT_EQ(one.ruin_times, three.ruin_times);
+    EXPECT_DOUBLE_EQ(one.mean_final_capital, three.mean_final_capital);
+    // Fee below the expected win of an unlimited bank: most casinos go broke
+    EXPECT_GT(one.ruin_probability.mean, 0.5);
+    EXPECT_LE(one.ruin_time_quantile(0.5), one.ruin_time_quantile(0.9));
+    EXPECT_LE(one.ruin_time_quantile(0.9), 1000U);
+}
+
+TEST(EnsembleTest, many_blocks)
+{
+    SimulationOptions options;
+    options.seed = 6;
+    options.threads = 2;
+    CasinoModel model;
+    model.capital = 16;
+    model.fee = 0;
+    model.max_games = 1;
+    // Block setup must not grow with the number of blocks before it
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = simulate_ensemble(1UL << 21, model, options);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+    EXPECT_NEAR(0.0625, result.ruin_probability.mean, 5 * result.ruin_probability.std_error);
+}
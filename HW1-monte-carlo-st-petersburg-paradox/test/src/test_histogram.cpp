@@ -0,0 +1,150 @@
+#include "level_histogram.h"
+#include "st_petersburg.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+TEST(LevelHistogramTest, levels)
+{
+    EXPECT_EQ(0U, max_level(1));
+    EXPECT_EQ(0U, max_level(2));
+    EXPECT_EQ(1U, max_level(3));
+    EXPECT_EQ(6U, max_level(100));
+    EXPECT_EQ(19U, max_level(1000000));
+    for (unsigned k = 1; k < 70; ++k) {
+        const double win = std::ldexp(2.0, static_cast<int>(k));
+        EXPECT_EQ(k, max_level(win));
+        EXPECT_EQ(k, max_level(std::nextafter(win, 0.0)));
+        EXPECT_EQ(k + 1, max_level(std::nextafter(win, 2 * win)));
+    }
+    EXPECT_EQ(0U, max_level(-5));
+    EXPECT_EQ(1023U, max_level(std::numeric_limits<double>::infinity()));
+    EXPECT_EQ(6U, LevelHistogram(128).level_cap());
+    EXPECT_DOUBLE_EQ(64, LevelHistogram(100).payout(5));
+    EXPECT_DOUBLE_EQ(100, LevelHistogram(100).payout(6));
+}
+
+TEST(LevelHistogramTest, statistics)
+{
+    LevelHistogram levels(100);
+    EXPECT_DOUBLE_EQ(0, levels.mean());
+    EXPECT_DOUBLE_EQ(0, levels.variance());
+    // Payouts 2, 2, 4, 100
+    levels.add(0, 2);
+    levels.add(1);
+    levels.add(6);
+    EXPECT_EQ(4U, levels.runs());
+    EXPECT_DOUBLE_EQ(27, levels.mean());
+    EXPECT_DOUBLE_EQ((2 * 25 * 25 + 23 * 23 + 73 * 73) / 3.0, levels.variance());
+    EXPECT_DOUBLE_EQ(2, levels.quantile(0));
+    EXPECT_DOUBLE_EQ(2, levels.quantile(0.5));
+    EXPECT_DOUBLE_EQ(4, levels.quantile(0.75));
+    EXPECT_DOUBLE_EQ(100, levels.quantile(0.99));
+    EXPECT_DOUBLE_EQ(100, levels.quantile(1));
+}
+
+TEST(LevelHistogramTest, merge)
+{
+    LevelHistogram a(1000);
+    LevelHistogram b(1000);
+    a.add(3, 5);
+    b.add(3, 7);
+    b.add(9);
+    a.merge(b);
+    EXPECT_EQ(12U, a.counts()[3]);
+    EXPECT_EQ(1U, a.counts()[9]);
+    EXPECT_THROW(a.merge(LevelHistogram(10)), std::invalid_argument);
+    // Same levels, but the top one pays another bankroll
+    EXPECT_THROW(LevelHistogram(100).merge(LevelHistogram(120)), std::invalid_argument);
+}
+
+TEST(LevelHistogramTest, simulation)
+{
+    SimulationOptions options;
+    options.seed = 11;
+    options.threads = 4;
+    options.engine = Engine::Bits;
+    const auto levels = simulate_levels(1000000, 100, options);
+    EXPECT_EQ(1000000U, levels.runs());
+    EXPECT_EQ(levels.mean(), calculate_expected_value(1000000, 100, options));
+    EXPECT_NEAR(7.56, levels.mean(), 1e-1);
+    EXPECT_DOUBLE_EQ(2, levels.quantile(0.4));
+    EXPECT_DOUBLE_EQ(4, levels.quantile(0.6));
+    EXPECT_DOUBLE_EQ(100, levels.quantile(0.999));
+    // Analytic variance of the payout capped at 100 is 282.25 - 7.5625^2
+    EXPECT_NEAR(225.06, levels.variance(), 5);
+}
+
+TEST(LevelHistogramTest, with_bankroll)
+{
+    LevelHistogram levels(1000);
+    levels.add(0, 4);
+    levels.add(5, 2);
+    levels.add(9);
+    const auto capped = levels.with_bankroll(20);
+    EXPECT_EQ(4U, capped.level_cap());
+    EXPECT_EQ((std::vector<std::uint64_t>{4, 0, 0, 0, 3}), capped.counts());
+    EXPECT_DOUBLE_EQ((4 * 2 + 3 * 20) / 7.0, capped.mean());
+    EXPECT_EQ(levels.counts(), levels.with_bankroll(1000).counts());
+    EXPECT_THROW(levels.with_bankroll(2000), std::invalid_argument);
+}
+
+TEST(LevelHistogramTest, bankroll_sweep)
+{
+    SimulationOptions options;
+    options.seed = 17;
+    options.engine = Engine::Bits;
+    options.threads = 2;
+    const std::vector<double> bankrolls = {100, 1000000, 1000};
+    const auto values = calculate_expected_values(1000000, bankrolls, options);
+    ASSERT_EQ(3U, values.size());
+    EXPECT_NEAR(7.5625, values[0], 1e-1);
+    EXPECT_NEAR(10.953, values[2], 5e-1);
+    // Common random numbers: a larger cap never pays less on the same games
+    EXPECT_LE(values[0], values[2]);
+    EXPECT_LE(values[2], values[1]);
+    EXPECT_TRUE(calculate_expected_values(10, {}, options).empty());
+}
+
+TEST(LevelHistogramTest, game_rules)
+{
+    GameRules tripling;
+    tripling.multiplier = 3;
+    tripling.initial_bet = 1;
+    // Wins 1, 3, 9, 27, 81, 243 -> 100
+    const LevelHistogram levels(100, tripling);
+    EXPECT_EQ(5U, levels.level_cap());
+    EXPECT_DOUBLE_EQ(81, levels.payout(4));
+    EXPECT_DOUBLE_EQ(100, levels.payout(5));
+
+    GameRules rounds;
+    rounds.cap = CapPolicy::Rounds;
+    rounds.max_rounds = 3;
+    const LevelHistogram capped(100, rounds);
+    EXPECT_EQ(3U, capped.level_cap());
+    EXPECT_DOUBLE_EQ(16, capped.payout(3));
+    EXPECT_THROW(LevelHistogram(100).merge(capped), std::invalid_argument);
+
+    EXPECT_DOUBLE_EQ(0.3 * 0.3 * 0.7, level_probability(2, 5, 0.3));
+    EXPECT_DOUBLE_EQ(0.3 * 0.3 * 0.3, level_probability(3, 3, 0.3));
+    GameRules unfair;
+    unfair.tails_probability = 1;
+    EXPECT_THROW(LevelHistogram(100, unfair), std::invalid_argument);
+
+    // More rounds than a histogram holds are refused, not cut short
+    rounds.max_rounds = LEVEL_LIMIT;
+    EXPECT_EQ(LEVEL_LIMIT, LevelHistogram(1, rounds).level_cap());
+    rounds.max_rounds = LEVEL_LIMIT + 1;
+    EXPECT_THROW(LevelHistogram(1, rounds), std::invalid_argument);
+    // A win that never grows never reaches the bankroll
+    GameRules flat;
+    flat.multiplier = 1;
+    EXPECT_THROW(LevelHistogram(100, flat), std::invalid_argument);
+    flat.multiplier = 0.5;
+    EXPECT_THROW(flat.validate(), std::invalid_argument);
+    flat.cap = CapPolicy::Rounds;
+    flat.max_rounds = 4;
+    EXPECT_NO_THROW(flat.validate());
+}
@@ -0,0 +1,34 @@
+#include "lanes.h"
+#include "st_petersburg.h"
+
+#include <gtest/gtest.h>
+
+TEST(LanesTest, same_result_on_every_isa)
+{
+    LevelHistogram reference(1000);
+    play_lanes(100003, 5, 0, LaneIsa::Scalar, reference);
+    EXPECT_EQ(100003U, reference.runs());
+    for (const auto isa : {LaneIsa::Avx2, LaneIsa::Avx512, LaneIsa::Auto}) {
+        if (lane_isa_supported(isa)) {
+            LevelHistogram levels(1000);
+            play_lanes(100003, 5, 0, isa, levels);
+            EXPECT_EQ(reference.counts(), levels.counts());
+        }
+    }
+}
+
+TEST(LanesTest, engine)
+{
+    SimulationOptions options;
+    options.engine = Engine::Lanes;
+    EXPECT_NEAR(7.5625, calculate_expected_value(10000000, 100, options), 5e-2);
+    EXPECT_DOUBLE_EQ(0, calculate_expected_value(0, 100, options));
+    EXPECT_DOUBLE_EQ(2, calculate_expected_value(5, 2, options));
+
+    options.seed = 13;
+    options.threads = 3;
+    const auto levels = simulate_levels(1000000, 1000000, options);
+    EXPECT_EQ(1000000U, levels.runs());
+    EXPECT_NEAR(500000, levels.counts()[0], 2500);
+    EXPECT_NEAR(250000, levels.counts()[1], 2500);
+}
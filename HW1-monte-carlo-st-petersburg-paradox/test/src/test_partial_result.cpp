@@ -0,0 +1,100 @@
+#include "partial_result.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace {
+
+PartialResult play(const unsigned long runs, const std::uint64_t first_trial, const std::uint64_t seed = 3, const double bankroll = 1000)
+{
+    SimulationOptions options;
+    options.seed = seed;
+    options.rng = Rng::Philox;
+    options.first_trial = first_trial;
+    return make_partial_result(simulate_levels(runs, bankroll, options), options);
+}
+
+} // anonymous namespace
+
+TEST(PartialResultTest, round_trip)
+{
+    const PartialResult result = play(10000, 500);
+    std::stringstream file;
+    write_partial_result(file, result);
+    const PartialResult read = read_partial_result(file);
+    ASSERT_EQ(1U, read.ranges.size());
+    EXPECT_EQ(3U, read.ranges[0].seed);
+    EXPECT_EQ(Rng::Philox, read.ranges[0].rng);
+    EXPECT_EQ(500U, read.ranges[0].first_trial);
+    EXPECT_EQ(10000U, read.ranges[0].trials);
+    EXPECT_EQ(result.levels.counts(), read.levels.counts());
+    EXPECT_DOUBLE_EQ(result.moments.mean(), read.moments.mean());
+    EXPECT_DOUBLE_EQ(result.moments.variance(), read.moments.variance());
+
+    std::stringstream truncated(file.str().substr(0, 40));
+    EXPECT_THROW(read_partial_result(truncated), std::runtime_error);
+}
+
+TEST(PartialResultTest, merge_matches_single_run)
+{
+    // Disjoint Philox ranges are exactly the games of one run
+    const PartialResult merged = merge_partial_results({play(30000, 0), play(20000, 50000), play(20000, 30000)});
+    const PartialResult whole = play(70000, 0);
+    EXPECT_EQ(whole.levels.counts(), merged.levels.counts());
+    EXPECT_EQ(70000U, merged.moments.count());
+    EXPECT_NEAR(whole.moments.mean(), merged.moments.mean(), 1e-12);
+    EXPECT_NEAR(whole.moments.std_error(), merged.moments.std_error(), 1e-12);
+
+    // Adjacent ranges join
+    ASSERT_EQ(1U, merged.ranges.size());
+    EXPECT_EQ(0U, merged.ranges[0].first_trial);
+    EXPECT_EQ(70000U, merged.ranges[0].trials);
+
+    EXPECT_THROW(merge_partial_results({play(30000, 0), play(20000, 29999)}), std::invalid_argument);
+    // A gap between the ranges is kept, the union claims only the games it has
+    const PartialResult gapped = merge_partial_results({play(30000, 0), play(20000, 40000)});
+    ASSERT_EQ(2U, gapped.ranges.size());
+    EXPECT_EQ(40000U, gapped.ranges[1].first_trial);
+    EXPECT_THROW(merge_partial_results({gapped, play(20000, 25000)}), std::invalid_argument);
+    EXPECT_EQ(1U, merge_partial_results({gapped, play(10000, 30000)}).ranges.size());
+}
+
+TEST(PartialResultTest, merge_different_seeds)
+{
+    // Processes that each drew a seed of their own
+    const PartialResult merged = merge_partial_results({play(20000, 0, 11), play(20000, 0, 12)});
+    EXPECT_EQ(40000U, merged.trials());
+    ASSERT_EQ(2U, merged.ranges.size());
+    EXPECT_EQ(11U, merged.ranges[0].seed);
+    EXPECT_EQ(12U, merged.ranges[1].seed);
+
+    // Both streams survive a round trip and guard against merging the same games twice
+    std::stringstream file;
+    write_partial_result(file, merged);
+    const PartialResult read = read_partial_result(file);
+    ASSERT_EQ(2U, read.ranges.size());
+    EXPECT_EQ(12U, read.ranges[1].seed);
+    EXPECT_EQ(20000U, read.ranges[1].trials);
+    EXPECT_THROW(merge_partial_results({read, play(1000, 19999, 12)}), std::invalid_argument);
+    EXPECT_EQ(41000U, merge_partial_results({read, play(1000, 20000, 11)}).trials());
+}
+
+TEST(PartialResultTest, merge_different_bankrolls)
+{
+    // Bankrolls 100 and 120 have the same levels, the top one pays differently
+    EXPECT_THROW(merge_partial_results({play(20000, 0, 1, 100), play(20000, 20000, 1, 120)}), std::invalid_argument);
+}
+
+TEST(PartialResultTest, malformed_enums)
+{
+    std::stringstream file;
+    write_partial_result(file, play(1000, 0));
+    // Engine after magic and version, rng of the first range, cap policy of the rules
+    for (const std::size_t offset : {12U, 36U, 100U}) {
+        std::string bytes = file.str();
+        bytes.replace(offset, 8, 8, '\x7F');
+        std::stringstream corrupt(bytes);
+        EXPECT_THROW(read_partial_result(corrupt), std::runtime_error) << offset;
+    }
+}
@@ -0,0 +1,65 @@
+#include "quasi_random.h"
+#include "st_petersburg.h"
+#include "variance_reduction.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(QuasiRandomTest, scrambled_points)
+{
+    EXPECT_EQ(0x8000000000000000U, ScrambledVanDerCorput::reverse_bits(1));
+    EXPECT_EQ(0xC000000000000000U, ScrambledVanDerCorput::reverse_bits(3));
+
+    // Scrambling keeps one point in every interval of width 1/64
+    const ScrambledVanDerCorput points(123);
+    std::vector<int> hits(64, 0);
+    for (std::uint64_t i = 0; i < 64; ++i) {
+        const double u = points(i);
+        ASSERT_GE(u, 0);
+        ASSERT_LT(u, 1);
+        ++hits[static_cast<std::size_t>(u * 64)];
+    }
+    for (const int count : hits) {
+        EXPECT_EQ(1, count);
+    }
+
+    // Half of the points stop at level 0, a quarter at level 1, ...
+    std::vector<int> levels(7, 0);
+    for (std::uint64_t i = 0; i < 64; ++i) {
+        ++levels[points.leading_zeros(i, 6)];
+    }
+    EXPECT_EQ(32, levels[0]);
+    EXPECT_EQ(16, levels[1]);
+    EXPECT_EQ(8, levels[2]);
+    EXPECT_EQ(2, levels[5] + levels[6]);
+}
+
+TEST(QuasiRandomTest, quasi_engine)
+{
+    SimulationOptions options;
+    options.seed = 37;
+    options.engine = Engine::Quasi;
+    const double exact = exact_expected_value(1000);
+    const auto estimate = estimate_expected_value(200000, 1000, options);
+    EXPECT_NEAR(exact, estimate.mean, 5 * estimate.std_error);
+    EXPECT_GT(estimate.std_error, 0);
+    // Levels resolve almost exactly, so the error beats plain sampling by far
+    EXPECT_GT(estimate.variance_reduction, 100);
+    EXPECT_EQ(estimate.mean, calculate_expected_value(200000, 1000, options));
+
+    // 2^16 points per replicate hit each of the 9 levels exactly as often as they should
+    const auto dyadic = estimate_expected_value(1 << 20, 1000, options);
+    EXPECT_DOUBLE_EQ(exact, dyadic.mean);
+    EXPECT_DOUBLE_EQ(0, dyadic.std_error);
+
+    // Replicates own their scrambling
+    options.threads = 1;
+    const double reference = calculate_expected_value(10000, 1000, options);
+    options.threads = 3;
+    EXPECT_EQ(reference, calculate_expected_value(10000, 1000, options));
+
+    options.rules.tails_probability = 0.3;
+    const auto biased = estimate_expected_value(1 << 16, 1000, options);
+    EXPECT_NEAR(exact_expected_value(1000, options.rules), biased.mean, 5 * biased.std_error + 1e-9);
+}
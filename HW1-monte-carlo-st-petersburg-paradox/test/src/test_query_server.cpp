@@ -0,0 +1,143 @@
+#include "query_server.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Server on a socket of its own, served from a background thread
+class QueryServerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        server = std::make_unique<QueryServer>(path, 2, 10000);
+        serving = std::thread([this] { server->run(); });
+    }
+
+    void TearDown() override
+    {
+        server->stop();
+        serving.join();
+        server.reset();
+        EXPECT_FALSE(std::filesystem::exists(path));
+    }
+
+    const std::string path = unique_temp_path("st_petersburg_query_server");
+    std::unique_ptr<QueryServer> server;
+    std::thread serving;
+};
+
+Query seeded(const unsigned long runs, const std::uint64_t seed)
+{
+    Query query;
+    query.runs = runs;
+    query.bankroll = 1000;
+    query.seed = seed;
+    return query;
+}
+
+} // anonymous namespace
+
+TEST(QueryFormatTest, round_trip)
+{
+    Query query = seeded(123, 7);
+    query.engine = Engine::Bits;
+    query.relative_error = 0.01;
+    std::stringstream payload;
+    write_query(payload, query);
+    const Query read = read_query(payload);
+    EXPECT_EQ(123U, read.runs);
+    EXPECT_EQ(Engine::Bits, read.engine);
+    EXPECT_EQ(7U, read.seed.value());
+    EXPECT_DOUBLE_EQ(0.01, read.relative_error);
+
+    std::stringstream truncated(payload.str().substr(0, 20));
+    EXPECT_THROW(read_query(truncated), std::runtime_error);
+}
+
+TEST_F(QueryServerTest, matches_single_call)
+{
+    QueryClient client(path);
+    unsigned long previous = 0;
+    const Reply reply = client.run(seeded(55000, 3), [&](const Reply & progress) {
+        EXPECT_EQ(ReplyKind::Progress, progress.kind);
+        EXPECT_GT(progress.estimate.runs, previous);
+        previous = progress.estimate.runs;
+    });
+    // Chunks are keyed by their first game: the games of one Philox run
+    SimulationOptions options;
+    options.seed = 3;
+    options.rng = Rng::Philox;
+    const Estimate expected = estimate_expected_value(55000, 1000, options);
+    EXPECT_EQ(ReplyKind::Done, reply.kind);
+    EXPECT_EQ(3U, reply.seed);
+    EXPECT_EQ(55000U, reply.estimate.runs);
+    EXPECT_NEAR(expected.mean, reply.estimate.mean, 1e-9);
+    EXPECT_NEAR(expected.std_error, reply.estimate.std_error, 1e-9);
+    EXPECT_LT(previous, 55000U);
+
+    // Same connection serves the next query
+    EXPECT_EQ(1000U, client.run(seeded(1000, 4)).estimate.runs);
+}
+
+TEST_F(QueryServerTest, stops_at_target_error)
+{
+    Query query = seeded(10000000, 5);
+    query.relative_error = 0.05;
+    const Reply reply = QueryClient(path).run(query);
+    EXPECT_LT(reply.estimate.runs, 10000000U);
+    EXPECT_LE(reply.estimate.high - reply.estimate.mean, 0.05 * reply.estimate.mean);
+}
+
+TEST_F(QueryServerTest, concurrent_clients)
+{
+    // A long query does not hold back the short ones
+    std::thread slow([this] { QueryClient(path).run(seeded(500000, 1)); });
+    std::vector<std::thread> clients;
+    for (std::uint64_t i = 0; i < 4; ++i) {
+        clients.emplace_back([this, i] {
+            const Reply reply = QueryClient(path).run(seeded(30000, 10 + i));
+            EXPECT_EQ(30000U, reply.estimate.runs);
+        });
+    }
+    for (auto & client : clients) {
+        client.join();
+    }
+    slow.join();
+}
+
+TEST_F(QueryServerTest, drops_lost_clients)
+{
+    struct Leave
+    {
+    };
+    {
+        QueryClient client(path);
+        EXPECT_THROW(client.run(seeded(1000000000000, 3), [](const Reply &) { throw Leave{}; }), Leave);
+    }
+    // The rest of the games is cancelled and the reader leaves with the client
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (server->connections() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(0U, server->connections());
+    EXPECT_EQ(20000U, QueryClient(path).run(seeded(20000, 4)).estimate.runs);
+}
+
+TEST_F(QueryServerTest, rejects_bad_queries)
+{
+    QueryClient client(path);
+    Query query = seeded(1000, 1);
+    query.engine = Engine::Quasi;
+    EXPECT_THROW(client.run(query), std::runtime_error);
+    query = seeded(1000, 1);
+    query.bankroll = -1;
+    EXPECT_THROW(client.run(query), std::runtime_error);
+    EXPECT_EQ(1000U, client.run(seeded(1000, 1)).estimate.runs);
+}
@@ -0,0 +1,136 @@
+#include "result_cache.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Cache file of one test, removed before and after it
+class ResultCacheTest : public ::testing::Test
+{
+protected:
+    void SetUp() override { std::filesystem::remove(path); }
+    void TearDown() override { std::filesystem::remove(path); }
+
+    const std::string path = unique_temp_path("st_petersburg_result_cache");
+};
+
+} // anonymous namespace
+
+TEST_F(ResultCacheTest, repeated_query_hits)
+{
+    const auto expected = simulate_levels(20000, 1000, seeded_options(Engine::Flip, Rng::Philox, 5)).counts();
+    {
+        ResultCache cache(path);
+        EXPECT_EQ(expected, cache.simulate_levels(20000, 1000, seeded_options(Engine::Flip, Rng::Philox, 5)).counts());
+        EXPECT_EQ(1U, cache.misses());
+    }
+    // Entries outlive the process that stored them
+    ResultCache cache(path);
+    EXPECT_EQ(1U, cache.size());
+    EXPECT_EQ(expected, cache.simulate_levels(20000, 1000, seeded_options(Engine::Flip, Rng::Philox, 5)).counts());
+    EXPECT_DOUBLE_EQ(simulate_levels(20000, 1000, seeded_options(Engine::Flip, Rng::Philox, 5)).mean(), cache.calculate_expected_value(20000, 1000, seeded_options(Engine::Flip, Rng::Philox, 5)));
+    EXPECT_EQ(2U, cache.hits());
+    EXPECT_EQ(0U, cache.misses());
+
+    // Any other parameter is another entry
+    cache.simulate_levels(20000, 1000, seeded_options(Engine::Flip, Rng::Philox, 6));
+    cache.simulate_levels(20000, 2000, seeded_options(Engine::Flip, Rng::Philox, 5));
+    auto xoshiro = seeded_options(Engine::Flip, Rng::Philox, 5);
+    xoshiro.rng = Rng::Xoshiro;
+    cache.simulate_levels(20000, 1000, xoshiro);
+    EXPECT_EQ(3U, cache.misses());
+    EXPECT_EQ(4U, cache.size());
+
+    // Unseeded queries are not cached
+    cache.simulate_levels(1000, 1000, SimulationOptions{});
+    EXPECT_EQ(4U, cache.size());
+}
+
+TEST_F(ResultCacheTest, extends_shorter_run)
+{
+    ResultCache cache(path);
+    cache.simulate_levels(30000, 1000000, seeded_options(Engine::Flip, Rng::Philox, 9));
+    // Philox games of the longer run start with the cached ones
+    EXPECT_EQ(simulate_levels(50000, 1000000, seeded_options(Engine::Flip, Rng::Philox, 9)).counts(), cache.simulate_levels(50000, 1000000, seeded_options(Engine::Flip, Rng::Philox, 9)).counts());
+    EXPECT_EQ(1U, cache.extensions());
+    EXPECT_EQ(1U, cache.misses());
+    EXPECT_EQ(2U, cache.size());
+
+    // Xoshiro streams depend on the split, a longer run is played again
+    auto xoshiro = seeded_options(Engine::Flip, Rng::Philox, 9);
+    xoshiro.rng = Rng::Xoshiro;
+    xoshiro.threads = 2;
+    cache.simulate_levels(30000, 1000000, xoshiro);
+    EXPECT_EQ(simulate_levels(50000, 1000000, xoshiro).counts(), cache.simulate_levels(50000, 1000000, xoshiro).counts());
+    EXPECT_EQ(1U, cache.extensions());
+    EXPECT_EQ(3U, cache.misses());
+}
+
+TEST_F(ResultCacheTest, evicts_least_recently_used)
+{
+    // Room for two entries
+    ResultCache cache(path, 3000);
+    ASSERT_EQ(2U, cache.capacity());
+    cache.simulate_levels(1000, 100, seeded_options(Engine::Flip, Rng::Philox, 1));
+    cache.simulate_levels(1000, 100, seeded_options(Engine::Flip, Rng::Philox, 2));
+    cache.simulate_levels(1000, 100, seeded_options(Engine::Flip, Rng::Philox, 1));
+    cache.simulate_levels(1000, 100, seeded_options(Engine::Flip, Rng::Philox, 3));
+    EXPECT_EQ(2U, cache.size());
+    EXPECT_EQ(1U, cache.hits());
+
+    cache.simulate_levels(1000, 100, seeded_options(Engine::Flip, Rng::Philox, 1));
+    EXPECT_EQ(2U, cache.hits());
+    cache.simulate_levels(1000, 100, seeded_options(Engine::Flip, Rng::Philox, 2));
+    EXPECT_EQ(2U, cache.hits());
+
+    cache.clear();
+    EXPECT_EQ(0U, cache.size());
+}
+
+TEST_F(ResultCacheTest, probes_near_the_hash)
+{
+    ResultCache cache(path, 64 << 10);
+    ASSERT_GT(cache.capacity(), 32U);
+    // More entries than slots: each one is found where it was stored until evicted
+    for (std::uint64_t seed = 0; seed < 100; ++seed) {
+        cache.simulate_levels(100, 100, seeded_options(Engine::Flip, Rng::Philox, seed));
+        EXPECT_EQ(simulate_levels(100, 100, seeded_options(Engine::Flip, Rng::Philox, seed)).counts(), cache.simulate_levels(100, 100, seeded_options(Engine::Flip, Rng::Philox, seed)).counts());
+    }
+    EXPECT_EQ(100U, cache.hits());
+    EXPECT_EQ(100U, cache.misses());
+    EXPECT_LE(cache.size(), cache.capacity());
+    EXPECT_GT(cache.size(), cache.capacity() / 2);
+}
+
+TEST_F(ResultCacheTest, shared_by_threads)
+{
+    ResultCache cache(path);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache] {
+            for (std::uint64_t seed = 0; seed < 50; ++seed) {
+                cache.simulate_levels(200, 100, seeded_options(Engine::Flip, Rng::Philox, seed));
+            }
+        });
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(200U, cache.hits() + cache.misses());
+    EXPECT_EQ(50U, cache.size());
+    for (std::uint64_t seed = 0; seed < 50; ++seed) {
+        EXPECT_EQ(simulate_levels(200, 100, seeded_options(Engine::Flip, Rng::Philox, seed)).counts(), cache.simulate_levels(200, 100, seeded_options(Engine::Flip, Rng::Philox, seed)).counts());
+    }
+}
+
+TEST_F(ResultCacheTest, rejects_other_files)
+{
+    std::ofstream(path) << "not a cache";
+    EXPECT_THROW(ResultCache cache(path), std::runtime_error);
+}
@@ -0,0 +1,87 @@
+#include "simulation.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+TEST(SimulationTest, resume_matches_uninterrupted)
+{
+    SimulationOptions options;
+    options.seed = 42;
+    options.threads = 2;
+    for (const auto rng : {Rng::Xoshiro, Rng::Philox}) {
+        options.rng = rng;
+        Simulation whole(100000, 1000, options, 30000);
+        while (whole.step()) {
+        }
+
+        Simulation first(100000, 1000, options, 30000);
+        first.step();
+        first.step();
+        std::stringstream checkpoint;
+        first.save(checkpoint);
+        Simulation resumed = Simulation::load(checkpoint);
+        EXPECT_EQ(60000U, resumed.trials_done());
+        while (resumed.step()) {
+        }
+
+        EXPECT_TRUE(resumed.done());
+        EXPECT_EQ(whole.levels().counts(), resumed.levels().counts());
+        EXPECT_EQ(100000U, resumed.levels().runs());
+    }
+}
+
+TEST(SimulationTest, philox_matches_single_call)
+{
+    SimulationOptions options;
+    options.seed = 7;
+    options.rng = Rng::Philox;
+    Simulation simulation(50000, 1000000, options, 12345);
+    while (simulation.step()) {
+    }
+    EXPECT_EQ(simulate_levels(50000, 1000000, options).counts(), simulation.levels().counts());
+}
+
+TEST(SimulationTest, observer_after_load)
+{
+    SimulationOptions options;
+    options.seed = 6;
+    Simulation first(20000, 1000, options, 10000);
+    first.step();
+    std::stringstream checkpoint;
+    first.save(checkpoint);
+    Simulation resumed = Simulation::load(checkpoint);
+    EXPECT_FALSE(resumed.options().observer);
+
+    unsigned long observed = 0;
+    resumed.set_observer(
+        [&](const Progress & progress) {
+            observed = progress.trials;
+            return true;
+        },
+        0);
+    EXPECT_TRUE(resumed.step());
+    EXPECT_EQ(10000U, observed);
+    EXPECT_TRUE(resumed.done());
+}
+
+TEST(SimulationTest, malformed_checkpoint)
+{
+    std::stringstream garbage("not a checkpoint");
+    EXPECT_THROW(Simulation::load(garbage), std::runtime_error);
+
+    Simulation simulation(1000, 100, SimulationOptions{}, 100);
+    simulation.step();
+    std::stringstream checkpoint;
+    simulation.save(checkpoint);
+    std::stringstream truncated(checkpoint.str().substr(0, checkpoint.str().size() - 3));
+    EXPECT_THROW(Simulation::load(truncated), std::runtime_error);
+    // Out-of-range rng, then engine, after magic, version, runs, bankroll, interval, seed and threads
+    for (const std::size_t offset : {52U, 60U}) {
+        std::string bytes = checkpoint.str();
+        bytes.replace(offset, 8, 8, '\x7F');
+        std::stringstream corrupt(bytes);
+        EXPECT_THROW(Simulation::load(corrupt), std::runtime_error) << offset;
+    }
+    EXPECT_THROW(Simulation(1000, 100, SimulationOptions{}, 0), std::invalid_argument);
+}
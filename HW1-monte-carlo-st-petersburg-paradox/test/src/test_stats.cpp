@@ -0,0 +1,78 @@
+#include "running_stats.h"
+#include "st_petersburg.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+TEST(RunningStatsTest, welford)
+{
+    RunningStats stats;
+    EXPECT_DOUBLE_EQ(0, stats.std_error());
+    for (const double value : {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0}) {
+        stats.add(value);
+    }
+    EXPECT_EQ(8U, stats.count());
+    EXPECT_DOUBLE_EQ(5, stats.mean());
+    EXPECT_DOUBLE_EQ(32.0 / 7, stats.variance());
+    EXPECT_DOUBLE_EQ(std::sqrt(32.0 / 7 / 8), stats.std_error());
+}
+
+TEST(RunningStatsTest, merge)
+{
+    RunningStats all;
+    RunningStats left;
+    RunningStats right;
+    for (int i = 0; i < 100; ++i) {
+        const double value = i * i % 17;
+        all.add(value);
+        (i < 30 ? left : right).add(value);
+    }
+    left.merge(right);
+    EXPECT_EQ(all.count(), left.count());
+    EXPECT_NEAR(all.mean(), left.mean(), 1e-12);
+    EXPECT_NEAR(all.variance(), left.variance(), 1e-9);
+
+    LevelHistogram levels(100);
+    levels.add(0, 2);
+    levels.add(1);
+    levels.add(6);
+    const RunningStats from_levels(levels);
+    EXPECT_DOUBLE_EQ(levels.mean(), from_levels.mean());
+    EXPECT_DOUBLE_EQ(levels.variance(), from_levels.variance());
+}
+
+TEST(RunningStatsTest, normal_quantile)
+{
+    EXPECT_NEAR(0, normal_quantile(0.5), 1e-9);
+    EXPECT_NEAR(1.959963985, normal_quantile(0.975), 1e-8);
+    EXPECT_NEAR(-2.326347874, normal_quantile(0.01), 1e-8);
+    EXPECT_NEAR(3.090232306, normal_quantile(0.999), 1e-8);
+}
+
+TEST(RunningStatsTest, adaptive_stopping)
+{
+    SimulationOptions options;
+    options.seed = 23;
+    options.engine = Engine::Bits;
+    Precision precision;
+    precision.absolute_error = 0.05;
+    precision.chunk = 100000;
+    const auto estimate = estimate_expected_value(100, precision, options);
+    EXPECT_LE(1.959 * estimate.std_error, 0.05);
+    EXPECT_NEAR(7.5625, estimate.mean, 5 * estimate.std_error);
+    EXPECT_LE(estimate.low, estimate.mean);
+    EXPECT_GE(estimate.high, estimate.mean);
+    EXPECT_EQ(0U, estimate.runs % precision.chunk);
+    // Variance of a payout is 225, so about 350000 games are needed
+    EXPECT_GE(estimate.runs, 300000U);
+    EXPECT_LE(estimate.runs, 500000U);
+
+    precision.absolute_error = 0;
+    precision.relative_error = 1e-9;
+    precision.max_runs = 250000;
+    EXPECT_EQ(250000U, estimate_expected_value(100, precision, options).runs);
+
+    // No target would play max_runs games without a word
+    EXPECT_THROW(estimate_expected_value(100, Precision{}, options), std::invalid_argument);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "level_histogram.h"
+#include "st_petersburg.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+// Options of the fast test mode: a fixed seed and a fixed number of threads,
+// so that a run gives the same games on every machine
+inline SimulationOptions seeded_options(const Engine engine = Engine::Flip, const Rng rng = Rng::Xoshiro, const std::uint64_t seed = 1)
+{
+    SimulationOptions options;
+    options.seed = seed;
+    options.threads = 2;
+    options.engine = engine;
+    options.rng = rng;
+    return options;
+}
+
+// Mean and variance of a single payout from the level probabilities
+struct PayoutMoments
+{
+    double mean = 0;
+    double variance = 0;
+};
+
+inline PayoutMoments payout_moments(const double bankroll, const GameRules & rules = GameRules{})
+{
+    const LevelHistogram payouts(bankroll, rules);
+    long double mean = 0;
+    long double second_moment = 0;
+    for (unsigned level = 0; level <= payouts.level_cap(); ++level) {
+        const long double p = level_probability(level, payouts.level_cap(), rules.tails_probability);
+        const long double x = payouts.payout(level);
+        mean += p * x;
+        second_moment += p * x * x;
+    }
+    return {static_cast<double>(mean), static_cast<double>(second_moment - mean * mean)};
+}
+
+// Mean of the games within `sigmas` standard errors of the expected value. The error
+// comes from the exact variance: the sample one of a heavy tail is mostly too small
+inline ::testing::AssertionResult near_expected(const LevelHistogram & levels, const double sigmas = 5)
+{
+    const auto moments = payout_moments(levels.bankroll(), levels.rules());
+    const double std_error = std::sqrt(moments.variance / static_cast<double>(levels.runs()));
+    if (std::abs(levels.mean() - moments.mean) <= sigmas * std_error) {
+        return ::testing::AssertionSuccess();
+    }
+    return ::testing::AssertionFailure() << "mean " << levels.mean() << " of " << levels.runs() << " games is "
+                                         << std::abs(levels.mean() - moments.mean) / std_error
+                                         << " standard errors away from " << moments.mean;
+}
+
+// Games of every level within `sigmas` binomial standard deviations of their expected number
+inline ::testing::AssertionResult levels_distributed(const LevelHistogram & levels, const double sigmas = 5)
+{
+    const double runs = static_cast<double>(levels.runs());
+    for (unsigned level = 0; level <= levels.level_cap(); ++level) {
+        const double p = level_probability(level, levels.level_cap(), levels.rules().tails_probability);
+        const double expected = runs * p;
+        const double deviation = std::sqrt(runs * p * (1 - p));
+        // Half a game of slack for levels too rare to be seen
+        if (std::abs(static_cast<double>(levels.counts()[level]) - expected) > sigmas * deviation + 0.5) {
+            return ::testing::AssertionFailure() << levels.counts()[level] << " games at level " << level
+                                                 << " of " << levels.runs() << ", expected " << expected;
+        }
+    }
+    return ::testing::AssertionSuccess();
+}
+
+// File in the temporary directory of the running test alone, so that parallel
+// runs of the suite do not share it
+inline std::string unique_temp_path(const std::string & prefix)
+{
+    const auto * test = ::testing::UnitTest::GetInstance()->current_test_info();
+    const std::string name = prefix + "_" + std::to_string(getpid()) + "_" + test->test_suite_name() + "_" + test->name();
+    return (std::filesystem::temp_directory_path() / name).string();
+}
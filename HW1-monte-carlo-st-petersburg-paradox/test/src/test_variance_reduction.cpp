@@ -0,0 +1,102 @@
+#include "st_petersburg.h"
+#include "variance_reduction.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+TEST(VarianceReductionTest, payout_variance)
+{
+    EXPECT_NEAR(282.25 - 7.5625 * 7.5625, payout_variance(100), 1e-9);
+    EXPECT_DOUBLE_EQ(0, payout_variance(2));
+    const double q = optimal_importance_tails(1000000);
+    EXPECT_GT(q, 0.5);
+    EXPECT_LT(q, 1);
+    EXPECT_DOUBLE_EQ(0.5, optimal_importance_tails(2));
+}
+
+TEST(VarianceReductionTest, stratified)
+{
+    SimulationOptions options;
+    options.seed = 29;
+    options.estimator = Estimator::Stratified;
+    // Strata of 16 replicates of 6250 games resolve every level below the cap
+    const auto estimate = estimate_expected_value(100000, 1000, options);
+    EXPECT_EQ(100000U, estimate.runs);
+    EXPECT_NEAR(10.9531, estimate.mean, 5 * estimate.std_error);
+    EXPECT_GT(estimate.variance_reduction, 100);
+    EXPECT_EQ(estimate.mean, calculate_expected_value(100000, 1000, options));
+
+    // Replicates own their streams
+    options.threads = 1;
+    const double reference = calculate_expected_value(10000, 1000, options);
+    options.threads = 3;
+    EXPECT_EQ(reference, calculate_expected_value(10000, 1000, options));
+}
+
+TEST(VarianceReductionTest, importance)
+{
+    SimulationOptions options;
+    options.seed = 31;
+    options.estimator = Estimator::Importance;
+    const auto estimate = estimate_expected_value(100000, 1000000, options);
+    EXPECT_NEAR(20.9073, estimate.mean, 5 * estimate.std_error);
+    EXPECT_GT(estimate.variance_reduction, 10);
+    EXPECT_LT(estimate.std_error, 0.1);
+
+    // Fair coin is the plain estimator
+    options.importance_tails = 0.5;
+    EXPECT_NEAR(1, estimate_expected_value(100000, 100, options).variance_reduction, 0.2);
+
+    // A coin that always or never shows Tails gives no weights
+    for (const double q : {0.0, 1.0, -0.5, 1.5}) {
+        options.importance_tails = q;
+        EXPECT_THROW(estimate_expected_value(1000, 100, options), std::invalid_argument) << q;
+    }
+}
+
+TEST(VarianceReductionTest, plain)
+{
+    SimulationOptions options;
+    options.seed = 37;
+    options.engine = Engine::Bits;
+    const auto estimate = estimate_expected_value(1000000, 100, options);
+    EXPECT_NEAR(7.5625, estimate.mean, 5 * estimate.std_error);
+    EXPECT_NEAR(std::sqrt(225.06 / 1000000), estimate.std_error, 2e-3);
+    EXPECT_DOUBLE_EQ(1, estimate.variance_reduction);
+}
+
+TEST(VarianceReductionTest, exact)
+{
+    EXPECT_DOUBLE_EQ(7.5625, exact_expected_value(100));
+    EXPECT_DOUBLE_EQ(19 + 1000000 / 524288.0, exact_expected_value(1000000));
+    EXPECT_DOUBLE_EQ(1.5, exact_expected_value(1.5));
+    EXPECT_DOUBLE_EQ(2, exact_expected_value(2));
+
+    SimulationOptions options;
+    options.estimator = Estimator::Exact;
+    const auto estimate = estimate_expected_value(0, 1000000, options);
+    EXPECT_DOUBLE_EQ(exact_expected_value(1000000), estimate.mean);
+    EXPECT_DOUBLE_EQ(0, estimate.std_error);
+}
+
+TEST(VarianceReductionTest, hybrid)
+{
+    SimulationOptions options;
+    options.seed = 41;
+    options.engine = Engine::Bits;
+    options.estimator = Estimator::Hybrid;
+    const auto estimate = estimate_expected_value(1000000, 1000000, options);
+    EXPECT_NEAR(exact_expected_value(1000000), estimate.mean, 5 * estimate.std_error);
+    // Only the first 10 levels are random
+    EXPECT_LT(estimate.std_error, 0.05);
+    EXPECT_GT(estimate.variance_reduction, 100);
+
+    // Depth is limited by the cap
+    options.hybrid_levels = 100;
+    const auto capped = estimate_expected_value(100000, 100, options);
+    EXPECT_NEAR(7.5625, capped.mean, 5 * capped.std_error);
+    // No levels simulated is the exact value
+    options.hybrid_levels = 0;
+    EXPECT_DOUBLE_EQ(7.5625, calculate_expected_value(100, 100, options));
+}